@@ -0,0 +1,85 @@
+//
+//  AlignedImage.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "AlignedImage.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace TransformFlow
+{
+	void AlignedImage::allocate(const std::vector<LineSegment2> & segments)
+	{
+		_rows.clear();
+
+		std::size_t offset = 0;
+
+		for (auto & segment : segments) {
+			Vec2 direction = segment.end() - segment.start();
+
+			// One sample per pixel along the segment:
+			std::size_t count = direction.length();
+
+			Row row = {segment.start(), ZERO, offset, count};
+
+			if (count > 0)
+				row.step = direction / RealT(count);
+
+			_rows.push_back(row);
+
+			offset += count;
+		}
+
+		_buffer.resize(offset);
+	}
+
+	template <typename PixelT>
+	static void sample_row(const PixelPlane & plane, const AlignedImage::Row & row, RealT * output)
+	{
+		const int width = plane.width, height = plane.height;
+
+		for (std::size_t i = 0; i < row.count; i += 1) {
+			Vec2 position = row.position(i);
+
+			// Flip from bottom left to top left origin in the same way as the line scanner, which places pixel centers on integer coordinates:
+			RealT px = position[X], py = height - position[Y];
+
+			// Bilinear interpolation between the four nearest pixels, clamped to the edge of the image:
+			int x = std::min(std::max(int(std::floor(px)), 0), std::max(width - 2, 0));
+			int y = std::min(std::max(int(std::floor(py)), 0), std::max(height - 2, 0));
+
+			RealT fx = std::min<RealT>(std::max<RealT>(px - x, 0), 1);
+			RealT fy = std::min<RealT>(std::max<RealT>(py - y, 0), 1);
+
+			const ByteT * top = plane.pixel(x, y);
+			const ByteT * bottom = (y + 1 < height) ? top + plane.stride : top;
+			const std::size_t right = (x + 1 < width) ? PixelT::channels : 0;
+
+			RealT a = PixelT::intensity(top) + (PixelT::intensity(top + right) - PixelT::intensity(top)) * fx;
+			RealT b = PixelT::intensity(bottom) + (PixelT::intensity(bottom + right) - PixelT::intensity(bottom)) * fx;
+
+			output[i] = a + (b - a) * fy;
+		}
+	}
+
+	struct RowSampler
+	{
+		const PixelPlane & plane;
+		const AlignedImage::Row & row;
+		RealT * output;
+
+		template <typename PixelT>
+		void operator()(PixelT) {
+			sample_row<PixelT>(plane, row, output);
+		}
+	};
+
+	void AlignedImage::sample(const PixelPlane & plane, std::size_t index)
+	{
+		auto & row = _rows[index];
+
+		dispatch_pixel_type(plane, RowSampler{plane, row, _buffer.data() + row.offset});
+	}
+}
@@ -0,0 +1,53 @@
+//
+//  AlignedImage.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_ALIGNEDIMAGE_H
+#define TRANSFORMFLOW_ALIGNEDIMAGE_H
+
+#include "PixelPlane.h"
+
+#include <Euclid/Geometry/Line.h>
+
+#include <vector>
+
+namespace TransformFlow
+{
+	using namespace Dream;
+	using namespace Dream::Imaging;
+	using namespace Euclid::Numerics;
+	using namespace Euclid::Geometry;
+
+	// A single channel copy of an image, resampled along a set of line segments (typically perpendicular to gravity). Each row is contiguous in memory, so it can be processed linearly regardless of the orientation of the original segments.
+	class AlignedImage
+	{
+	public:
+		struct Row {
+			// The image coordinate of the first sample, and the step between successive samples. Image coordinates have the origin in the bottom left.
+			Vec2 origin, step;
+
+			// The location of the samples in the buffer:
+			std::size_t offset, count;
+
+			// Map a (fractional) sample index back to image coordinates.
+			Vec2 position(RealT index) const { return origin + step * index; }
+		};
+
+		// Lays out one row per segment. This doesn't sample the image, so that rows can be sampled in parallel afterwards.
+		void allocate(const std::vector<LineSegment2> & segments);
+
+		// Sample the intensities along the given row from the image.
+		void sample(const PixelPlane & plane, std::size_t index);
+
+		const std::vector<Row> & rows() const { return _rows; }
+
+		const RealT * row_data(std::size_t index) const { return _buffer.data() + _rows[index].offset; }
+
+	protected:
+		std::vector<Row> _rows;
+		std::vector<RealT> _buffer;
+	};
+}
+
+#endif
@@ -0,0 +1,177 @@
+//
+//  CSVParser.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "CSVParser.h"
+
+#include <cstdlib>
+
+namespace TransformFlow
+{
+	static bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	static bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// Every power of ten up to 10^22 is exactly representable as a double:
+	static const double POWERS_OF_TEN[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Digits beyond this can't change the result of the fast path, and would overflow the mantissa:
+	static const int MAXIMUM_DIGITS = 19;
+
+	static double parse_double(const char * begin, const char * end)
+	{
+		const char * current = begin;
+		bool negative = false;
+
+		if (current != end && (*current == '-' || *current == '+')) {
+			negative = (*current == '-');
+			current += 1;
+		}
+
+		std::uint64_t mantissa = 0;
+		int digits = 0, exponent = 0;
+		bool valid = false;
+
+		for (; current != end && is_digit(*current); current += 1) {
+			valid = true;
+
+			if (digits < MAXIMUM_DIGITS) {
+				mantissa = mantissa * 10 + (*current - '0');
+				if (mantissa) digits += 1;
+			} else {
+				exponent += 1;
+			}
+		}
+
+		if (current != end && *current == '.') {
+			current += 1;
+
+			for (; current != end && is_digit(*current); current += 1) {
+				valid = true;
+
+				if (digits < MAXIMUM_DIGITS) {
+					mantissa = mantissa * 10 + (*current - '0');
+					if (mantissa) digits += 1;
+					exponent -= 1;
+				}
+			}
+		}
+
+		if (valid && current != end && (*current == 'e' || *current == 'E')) {
+			const char * exponent_begin = current + 1;
+			bool exponent_negative = false;
+
+			if (exponent_begin != end && (*exponent_begin == '-' || *exponent_begin == '+')) {
+				exponent_negative = (*exponent_begin == '-');
+				exponent_begin += 1;
+			}
+
+			if (exponent_begin != end && is_digit(*exponent_begin)) {
+				int value = 0;
+
+				for (current = exponent_begin; current != end && is_digit(*current); current += 1) {
+					if (value < 10000)
+						value = value * 10 + (*current - '0');
+				}
+
+				exponent += exponent_negative ? -value : value;
+			}
+		}
+
+		double value;
+
+		// Both the mantissa and the power of ten are exact, so a single multiplication or division is correctly rounded:
+		if (valid && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+			if (exponent < 0)
+				value = double(mantissa) / POWERS_OF_TEN[-exponent];
+			else
+				value = double(mantissa) * POWERS_OF_TEN[exponent];
+
+			return negative ? -value : value;
+		}
+
+		// Long mantissas, large exponents and special values like "nan" are rare, so the field is copied so that it can be null terminated:
+		std::string field(begin, end);
+		return std::strtod(field.c_str(), nullptr);
+	}
+
+	std::uint32_t CSVField::hash() const
+	{
+		std::uint32_t value = 2166136261u;
+
+		for (const char * current = begin; current != end; current += 1)
+			value = (value ^ std::uint32_t((unsigned char)*current)) * 16777619u;
+
+		return value;
+	}
+
+	template <>
+	double CSVField::to<double>() const
+	{
+		return parse_double(begin, end);
+	}
+
+	template <>
+	float CSVField::to<float>() const
+	{
+		return float(parse_double(begin, end));
+	}
+
+	template <>
+	std::size_t CSVField::to<std::size_t>() const
+	{
+		std::size_t value = 0;
+
+		for (const char * current = begin; current != end && is_digit(*current); current += 1)
+			value = value * 10 + (*current - '0');
+
+		return value;
+	}
+
+	CSVParser::CSVParser(const char * begin, const char * end) : _current(begin), _end(end)
+	{
+	}
+
+	bool CSVParser::next_row()
+	{
+		if (_current == _end) return false;
+
+		_row.clear();
+
+		while (true) {
+			const char * begin = _current;
+
+			while (_current != _end && *_current != ',' && *_current != '\n')
+				_current += 1;
+
+			const char * end = _current;
+
+			while (begin != end && is_space(*begin))
+				begin += 1;
+
+			while (begin != end && is_space(*(end - 1)))
+				end -= 1;
+
+			_row.push_back({begin, end});
+
+			if (_current == _end) break;
+
+			char delimiter = *_current;
+			_current += 1;
+
+			if (delimiter == '\n') break;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,71 @@
+//
+//  CSVParser.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_CSVPARSER_H
+#define TRANSFORMFLOW_CSVPARSER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TransformFlow
+{
+	// FNV-1a, which can be evaluated at compile time so that names can be used as case labels.
+	constexpr std::uint32_t hash_name(const char * name, std::uint32_t value = 2166136261u)
+	{
+		return *name ? hash_name(name + 1, (value ^ std::uint32_t((unsigned char)*name)) * 16777619u) : value;
+	}
+
+	// A field within a buffer of CSV data, which must outlive it. Nothing is copied.
+	struct CSVField
+	{
+		const char * begin;
+		const char * end;
+
+		std::size_t size() const { return end - begin; }
+		bool empty() const { return begin == end; }
+
+		std::string str() const { return std::string(begin, end); }
+
+		// The same as hash_name(str().c_str()).
+		std::uint32_t hash() const;
+
+		// Parse the field as a number. Like reading from a stream, parsing stops at the first character which isn't part of the number, and a field which doesn't start with a number gives zero. Supported for double, float and std::size_t.
+		template <typename NumberT>
+		NumberT to() const;
+	};
+
+	template <> double CSVField::to<double>() const;
+	template <> float CSVField::to<float>() const;
+	template <> std::size_t CSVField::to<std::size_t>() const;
+
+	// Splits a buffer of CSV data into rows of comma separated fields, with surrounding white space removed. Quoting is not supported. The fields are reused for each row, so after the first few rows, parsing doesn't allocate.
+	class CSVParser
+	{
+	public:
+		typedef std::vector<CSVField> RowT;
+
+		CSVParser(const char * begin, const char * end);
+
+		// Move to the next row, returning false if there are no more rows. Empty lines give a row with one empty field.
+		bool next_row();
+
+		const RowT & row() const { return _row; }
+
+		// The start of the next row, which can be given to seek() to read it again.
+		const char * position() const { return _current; }
+
+		// Continue parsing from the given position, which must be the start of a row within the buffer.
+		void seek(const char * position) { _current = position; }
+
+	protected:
+		const char * _current;
+		const char * _end;
+
+		RowT _row;
+	};
+}
+
+#endif
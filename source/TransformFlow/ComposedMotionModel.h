@@ -0,0 +1,162 @@
+//
+//  ComposedMotionModel.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_COMPOSEDMOTIONMODEL_H
+#define TRANSFORMFLOW_COMPOSEDMOTIONMODEL_H
+
+#include "SensorFusion.h"
+#include "VisionCorrection.h"
+
+#include <utility>
+
+namespace TransformFlow
+{
+	// A vision stage which does nothing, for a model which only uses the sensors.
+	struct NoVision
+	{
+		struct State {};
+
+		void update(const ImageUpdate & image_update, const Vec3 & gravity, Radians<> relative_rotation, RealT bearing) {}
+
+		bool uses_images() const { return false; }
+		bool primed() const { return false; }
+		RealT corrected_bearing() const { return 0; }
+
+		State state() { return State(); }
+		void restore(const State & state) {}
+	};
+
+	/*
+		A motion model composed from a sensor fusion stage and a vision correction stage at compile time. None of the updates are virtual, so when the concrete type is used directly, e.g. replaying SensorEvents with a visitor, the compiler can inline the whole model. This is the same model as HybridMotionModel in synchronous mode, or BasicSensorMotionModel when composed with NoVision.
+
+		The fusion stage has the interface of SensorFusion, and the vision stage has the interface of VisionCorrection. The arguments to the constructor are given to the vision stage. Use StaticMotionModel to use it as a MotionModel, e.g. with VideoStream.
+	 */
+	template <typename FusionT = SensorFusion, typename VisionT = VisionCorrection>
+	class ComposedMotionModel
+	{
+	public:
+		typedef FusionT Fusion;
+		typedef VisionT Vision;
+
+		struct State
+		{
+			typename FusionT::State fusion;
+			typename VisionT::State vision;
+		};
+
+		template <typename... ArgumentsT>
+		ComposedMotionModel(ArgumentsT &&... arguments) : _vision(std::forward<ArgumentsT>(arguments)...)
+		{
+		}
+
+		void update(const LocationUpdate & location_update) { _fusion.update(location_update); }
+		void update(const HeadingUpdate & heading_update) { _fusion.update(heading_update); }
+		void update(const MotionUpdate & motion_update) { _fusion.update(motion_update); }
+		void update(const MotionUpdate * motion_updates, std::size_t count) { _fusion.update(motion_updates, count); }
+
+		void update(const ImageUpdate & image_update)
+		{
+			if (!localization_valid()) return;
+
+			_vision.update(image_update, _fusion.gravity(), _fusion.relative_rotation(), _fusion.bearing());
+		}
+
+		bool localization_valid() const
+		{
+			return !_fusion.gravity().equivalent({0, 0, 0}) && _fusion.primed();
+		}
+
+		bool uses_images() const { return _vision.uses_images(); }
+
+		const Vec3 & gravity() const { return _fusion.gravity(); }
+		const Vec3 & position() const { return _fusion.position(); }
+
+		// Measured in degrees from north.
+		RealT bearing() const
+		{
+			if (_vision.primed())
+				return _vision.corrected_bearing();
+			else
+				return _fusion.bearing();
+		}
+
+		FusionT & fusion() { return _fusion; }
+		VisionT & vision() { return _vision; }
+
+		State state() { return State{_fusion.state(), _vision.state()}; }
+
+		void restore(const State & state)
+		{
+			_fusion.restore(state.fusion);
+			_vision.restore(state.vision);
+		}
+
+	protected:
+		FusionT _fusion;
+		VisionT _vision;
+	};
+
+	typedef ComposedMotionModel<SensorFusion, VisionCorrection> ComposedHybridMotionModel;
+	typedef ComposedMotionModel<SensorFusion, NoVision> ComposedSensorMotionModel;
+
+	// Adapts a model with the same interface as ComposedMotionModel to the MotionModel interface, so that it can be used where a Ref<MotionModel> is needed. Each update costs one virtual call, after which the model is inlined.
+	template <typename ModelT>
+	class StaticMotionModel : public MotionModel
+	{
+	public:
+		struct Snapshot : public MotionModel::Snapshot
+		{
+			typename ModelT::State state;
+		};
+
+		template <typename... ArgumentsT>
+		StaticMotionModel(ArgumentsT &&... arguments) : _model(std::forward<ArgumentsT>(arguments)...)
+		{
+		}
+
+		virtual ~StaticMotionModel()
+		{
+		}
+
+		ModelT & model() { return _model; }
+		const ModelT & model() const { return _model; }
+
+		virtual Ref<MotionModel::Snapshot> snapshot() final
+		{
+			Ref<Snapshot> snapshot = new Snapshot;
+
+			save(*snapshot);
+			snapshot->state = _model.state();
+
+			return snapshot;
+		}
+
+		virtual void restore(const MotionModel::Snapshot & snapshot) final
+		{
+			const Snapshot & static_snapshot = snapshot_cast<Snapshot>(snapshot);
+
+			load(static_snapshot);
+			_model.restore(static_snapshot.state);
+		}
+
+		virtual void update(const LocationUpdate & location_update) final { _model.update(location_update); }
+		virtual void update(const HeadingUpdate & heading_update) final { _model.update(heading_update); }
+		virtual void update(const MotionUpdate & motion_update) final { _model.update(motion_update); }
+		virtual void update(const ImageUpdate & image_update) final { _model.update(image_update); }
+		virtual void update(const MotionUpdate * motion_updates, std::size_t count) final { _model.update(motion_updates, count); }
+
+		virtual bool localization_valid() const final { return _model.localization_valid(); }
+		virtual bool uses_images() const final { return _model.uses_images(); }
+
+		virtual const Vec3 & gravity() const final { return _model.gravity(); }
+		virtual const Vec3 & position() const final { return _model.position(); }
+		virtual Radians<> bearing() const final { return degrees(_model.bearing()); }
+
+	protected:
+		ModelT _model;
+	};
+}
+
+#endif
@@ -0,0 +1,444 @@
+//
+//  Dataset.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "Dataset.h"
+#include "VideoStream.h"
+
+#include <Dream/Core/Data.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace TransformFlow
+{
+	const char * Dataset::RESOURCE_NAME = "dataset";
+
+	static const char MAGIC[8] = {'T', 'F', 'D', 'A', 'T', 'A', '\0', '\0'};
+
+	// Written as a native integer, so that a file from a machine with a different byte order can be detected:
+	static const std::uint32_t BYTE_ORDER = 0x01020304;
+
+	static const std::size_t SECTION_ALIGNMENT = 8;
+
+	struct FileHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		std::uint64_t section_count;
+	};
+
+	struct SectionHeader
+	{
+		std::uint32_t column;
+		std::uint32_t element_size;
+		std::uint64_t count;
+		std::uint64_t offset;
+	};
+
+	static std::size_t element_size(Dataset::Column column)
+	{
+		typedef Dataset::Column Column;
+
+		switch (column) {
+			case Column::EVENTS:
+			case Column::FRAME_DATA:
+				return 1;
+
+			case Column::MOTION_ROTATION_RATE:
+			case Column::MOTION_ACCELERATION:
+			case Column::MOTION_GRAVITY:
+				return sizeof(float) * 3;
+
+			case Column::FRAME_FIELD_OF_VIEW:
+				return sizeof(float);
+
+			case Column::FRAME_INDEX:
+			case Column::FRAME_OFFSETS:
+				return sizeof(std::uint64_t);
+
+			default:
+				return sizeof(double);
+		}
+	}
+
+	Dataset::Dataset(Shared<Buffer> buffer) : _buffer(buffer), _data(buffer->begin()), _size(buffer->size())
+	{
+		read_directory();
+	}
+
+	Dataset::Dataset(const ByteT * data, std::size_t size) : _data(data), _size(size)
+	{
+		read_directory();
+	}
+
+	Dataset::~Dataset()
+	{
+	}
+
+	void Dataset::read_directory()
+	{
+		if (_size < sizeof(FileHeader))
+			throw std::runtime_error("Data set is too small!");
+
+		const FileHeader * header = reinterpret_cast<const FileHeader *>(_data);
+
+		if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw std::runtime_error("Data set has invalid header!");
+
+		if (header->byte_order != BYTE_ORDER)
+			throw std::runtime_error("Data set has different byte order!");
+
+		if (header->version != VERSION)
+			throw std::runtime_error("Data set has unsupported version!");
+
+		if (header->section_count > (_size - sizeof(FileHeader)) / sizeof(SectionHeader))
+			throw std::runtime_error("Data set directory is truncated!");
+
+		const SectionHeader * sections = reinterpret_cast<const SectionHeader *>(_data + sizeof(FileHeader));
+
+		for (std::size_t i = 0; i < header->section_count; i += 1) {
+			const SectionHeader & section_header = sections[i];
+			Column column = Column(section_header.column);
+
+			Section * section = nullptr;
+
+			switch (column) {
+				case Column::EVENTS: section = &_events; break;
+
+				case Column::MOTION_TIME: section = &_motion_time; break;
+				case Column::MOTION_ROTATION_RATE: section = &_motion_rotation_rate; break;
+				case Column::MOTION_ACCELERATION: section = &_motion_acceleration; break;
+				case Column::MOTION_GRAVITY: section = &_motion_gravity; break;
+
+				case Column::LOCATION_TIME: section = &_location_time; break;
+				case Column::LOCATION_LATITUDE: section = &_location_latitude; break;
+				case Column::LOCATION_LONGITUDE: section = &_location_longitude; break;
+				case Column::LOCATION_ALTITUDE: section = &_location_altitude; break;
+				case Column::LOCATION_HORIZONTAL_ACCURACY: section = &_location_horizontal_accuracy; break;
+				case Column::LOCATION_VERTICAL_ACCURACY: section = &_location_vertical_accuracy; break;
+
+				case Column::HEADING_TIME: section = &_heading_time; break;
+				case Column::HEADING_MAGNETIC_BEARING: section = &_heading_magnetic_bearing; break;
+				case Column::HEADING_TRUE_BEARING: section = &_heading_true_bearing; break;
+
+				case Column::FRAME_TIME: section = &_frame_time; break;
+				case Column::FRAME_INDEX: section = &_frame_index; break;
+				case Column::FRAME_FIELD_OF_VIEW: section = &_frame_field_of_view; break;
+				case Column::FRAME_OFFSETS: section = &_frame_offsets; break;
+				case Column::FRAME_DATA: section = &_frame_data; break;
+			}
+
+			// Columns added by later versions can be skipped:
+			if (!section) continue;
+
+			if (section_header.element_size != element_size(column))
+				throw std::runtime_error("Data set column has unexpected element size!");
+
+			if (section_header.offset % SECTION_ALIGNMENT || section_header.offset > _size || section_header.count > (_size - section_header.offset) / section_header.element_size)
+				throw std::runtime_error("Data set column is outside the file!");
+
+			section->data = _data + section_header.offset;
+			section->count = section_header.count;
+		}
+
+		// Every column in a group must have a value for each row:
+		auto check_counts = [](std::initializer_list<const Section *> group) {
+			for (auto section : group)
+				if (section->count != (*group.begin())->count)
+					throw std::runtime_error("Data set columns have different lengths!");
+		};
+
+		check_counts({&_motion_time, &_motion_rotation_rate, &_motion_acceleration, &_motion_gravity});
+		check_counts({&_location_time, &_location_latitude, &_location_longitude, &_location_altitude, &_location_horizontal_accuracy, &_location_vertical_accuracy});
+		check_counts({&_heading_time, &_heading_magnetic_bearing, &_heading_true_bearing});
+		check_counts({&_frame_time, &_frame_index, &_frame_field_of_view});
+
+		if (_frame_offsets.count && _frame_offsets.count != _frame_time.count + 1)
+			throw std::runtime_error("Data set has inconsistent number of frame images!");
+
+		// Each event refers to the next row of the columns of its kind. The events and frame offsets are checked as they are read, rather than here, so that opening a data set doesn't depend on its length.
+	}
+
+	void Dataset::check_row(const Section & section, std::size_t index)
+	{
+		if (index >= section.count)
+			throw std::runtime_error("Data set has inconsistent number of events!");
+	}
+
+	Dataset::Event Dataset::event(std::size_t index) const
+	{
+		Event event = column<Event>(_events)[index];
+
+		if (std::uint8_t(event) > std::uint8_t(Event::FRAME))
+			throw std::runtime_error("Data set has unknown event!");
+
+		return event;
+	}
+
+	static Vec3 vector_at(const float * values, std::size_t index)
+	{
+		return Vec3(values[index*3], values[index*3+1], values[index*3+2]);
+	}
+
+	MotionUpdate Dataset::motion_update(std::size_t index) const
+	{
+		check_row(_motion_time, index);
+
+		MotionUpdate motion_update;
+
+		motion_update.time_offset = column<double>(_motion_time)[index];
+		motion_update.rotation_rate = vector_at(column<float>(_motion_rotation_rate), index);
+		motion_update.acceleration = vector_at(column<float>(_motion_acceleration), index);
+		motion_update.gravity = vector_at(column<float>(_motion_gravity), index);
+
+		return motion_update;
+	}
+
+	LocationUpdate Dataset::location_update(std::size_t index) const
+	{
+		check_row(_location_time, index);
+
+		LocationUpdate location_update;
+
+		location_update.time_offset = column<double>(_location_time)[index];
+		location_update.latitude = column<double>(_location_latitude)[index];
+		location_update.longitude = column<double>(_location_longitude)[index];
+		location_update.altitude = column<double>(_location_altitude)[index];
+
+		location_update.horizontal_accuracy = column<double>(_location_horizontal_accuracy)[index];
+		location_update.vertical_accuracy = column<double>(_location_vertical_accuracy)[index];
+
+		return location_update;
+	}
+
+	HeadingUpdate Dataset::heading_update(std::size_t index) const
+	{
+		check_row(_heading_time, index);
+
+		HeadingUpdate heading_update;
+
+		heading_update.time_offset = column<double>(_heading_time)[index];
+		heading_update.magnetic_bearing = column<double>(_heading_magnetic_bearing)[index];
+		heading_update.true_bearing = column<double>(_heading_true_bearing)[index];
+
+		return heading_update;
+	}
+
+	ImageUpdate Dataset::image_update(std::size_t index) const
+	{
+		check_row(_frame_time, index);
+
+		ImageUpdate image_update;
+
+		image_update.time_offset = column<double>(_frame_time)[index];
+		image_update.frame_index = column<std::uint64_t>(_frame_index)[index];
+		image_update.field_of_view = radians(RealT(column<float>(_frame_field_of_view)[index]));
+
+		return image_update;
+	}
+
+	Ref<Image> Dataset::load_frame(std::size_t index) const
+	{
+		if (!has_frame_data()) return nullptr;
+
+		check_row(_frame_time, index);
+
+		const std::uint64_t * offsets = column<std::uint64_t>(_frame_offsets);
+
+		if (offsets[index] > offsets[index+1])
+			throw std::runtime_error("Data set frame offsets are not increasing!");
+
+		if (offsets[index+1] > _frame_data.count)
+			throw std::runtime_error("Data set frame image is outside the file!");
+
+		// Equal offsets are a frame which wasn't stored:
+		if (offsets[index] == offsets[index+1]) return nullptr;
+
+		// The image is decoded directly from the mapped file:
+		Shared<Buffer> buffer = new StaticBuffer(_frame_data.data + offsets[index], offsets[index+1] - offsets[index]);
+
+		return Image::load_from_data(new BufferedData(buffer));
+	}
+
+	namespace
+	{
+		struct ColumnWriter
+		{
+			Dataset::Column column;
+			const void * data;
+			std::size_t count;
+		};
+
+		template <typename ValueT>
+		ColumnWriter column_writer(Dataset::Column column, const std::vector<ValueT> & values, std::size_t elements = 1)
+		{
+			return {column, values.data(), values.size() / elements};
+		}
+
+		static std::size_t aligned(std::size_t offset)
+		{
+			return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+		}
+	}
+
+	void Dataset::write(std::ostream & output, const std::vector<Shared<SensorUpdate>> & sensor_updates, FrameDataCallbackT frame_data)
+	{
+		std::vector<Event> events;
+
+		std::vector<double> motion_time;
+		std::vector<float> motion_rotation_rate, motion_acceleration, motion_gravity;
+
+		std::vector<double> location_time, location_latitude, location_longitude, location_altitude, location_horizontal_accuracy, location_vertical_accuracy;
+
+		std::vector<double> heading_time, heading_magnetic_bearing, heading_true_bearing;
+
+		std::vector<double> frame_time;
+		std::vector<std::uint64_t> frame_index, frame_offsets;
+		std::vector<float> frame_field_of_view;
+		std::vector<Shared<Buffer>> frame_buffers;
+		std::uint64_t frame_data_size = 0;
+
+		auto append_vector = [](std::vector<float> & values, const Vec3 & vector) {
+			values.push_back(vector[X]);
+			values.push_back(vector[Y]);
+			values.push_back(vector[Z]);
+		};
+
+		for (auto & sensor_update : sensor_updates) {
+			if (auto motion_update = dynamic_cast<const MotionUpdate *>(sensor_update.get())) {
+				events.push_back(Event::MOTION);
+
+				motion_time.push_back(motion_update->time_offset);
+				append_vector(motion_rotation_rate, motion_update->rotation_rate);
+				append_vector(motion_acceleration, motion_update->acceleration);
+				append_vector(motion_gravity, motion_update->gravity);
+			} else if (auto location_update = dynamic_cast<const LocationUpdate *>(sensor_update.get())) {
+				events.push_back(Event::LOCATION);
+
+				location_time.push_back(location_update->time_offset);
+				location_latitude.push_back(location_update->latitude);
+				location_longitude.push_back(location_update->longitude);
+				location_altitude.push_back(location_update->altitude);
+				location_horizontal_accuracy.push_back(location_update->horizontal_accuracy);
+				location_vertical_accuracy.push_back(location_update->vertical_accuracy);
+			} else if (auto heading_update = dynamic_cast<const HeadingUpdate *>(sensor_update.get())) {
+				events.push_back(Event::HEADING);
+
+				heading_time.push_back(heading_update->time_offset);
+				heading_magnetic_bearing.push_back(heading_update->magnetic_bearing);
+				heading_true_bearing.push_back(heading_update->true_bearing);
+			} else if (auto image_update = dynamic_cast<const ImageUpdate *>(sensor_update.get())) {
+				events.push_back(Event::FRAME);
+
+				frame_time.push_back(image_update->time_offset);
+				frame_index.push_back(image_update->frame_index);
+				frame_field_of_view.push_back(image_update->field_of_view / radians(RealT(1)));
+
+				if (frame_data) {
+					Shared<Buffer> buffer = frame_data(image_update->frame_index);
+
+					frame_offsets.push_back(frame_data_size);
+					frame_buffers.push_back(buffer);
+
+					if (buffer)
+						frame_data_size += buffer->size();
+				}
+			}
+		}
+
+		frame_offsets.push_back(frame_data_size);
+
+		std::vector<ColumnWriter> columns = {
+			column_writer(Column::EVENTS, events),
+
+			column_writer(Column::MOTION_TIME, motion_time),
+			column_writer(Column::MOTION_ROTATION_RATE, motion_rotation_rate, 3),
+			column_writer(Column::MOTION_ACCELERATION, motion_acceleration, 3),
+			column_writer(Column::MOTION_GRAVITY, motion_gravity, 3),
+
+			column_writer(Column::LOCATION_TIME, location_time),
+			column_writer(Column::LOCATION_LATITUDE, location_latitude),
+			column_writer(Column::LOCATION_LONGITUDE, location_longitude),
+			column_writer(Column::LOCATION_ALTITUDE, location_altitude),
+			column_writer(Column::LOCATION_HORIZONTAL_ACCURACY, location_horizontal_accuracy),
+			column_writer(Column::LOCATION_VERTICAL_ACCURACY, location_vertical_accuracy),
+
+			column_writer(Column::HEADING_TIME, heading_time),
+			column_writer(Column::HEADING_MAGNETIC_BEARING, heading_magnetic_bearing),
+			column_writer(Column::HEADING_TRUE_BEARING, heading_true_bearing),
+
+			column_writer(Column::FRAME_TIME, frame_time),
+			column_writer(Column::FRAME_INDEX, frame_index),
+			column_writer(Column::FRAME_FIELD_OF_VIEW, frame_field_of_view),
+		};
+
+		// The images are written directly from their buffers, rather than being copied into a column first:
+		if (frame_data) {
+			columns.push_back(column_writer(Column::FRAME_OFFSETS, frame_offsets));
+			columns.push_back({Column::FRAME_DATA, nullptr, (std::size_t)frame_data_size});
+		}
+
+		FileHeader header;
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.byte_order = BYTE_ORDER;
+		header.section_count = columns.size();
+
+		output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+		std::size_t offset = aligned(sizeof(FileHeader) + sizeof(SectionHeader) * columns.size());
+
+		for (auto & column : columns) {
+			SectionHeader section_header;
+
+			section_header.column = std::uint32_t(column.column);
+			section_header.element_size = element_size(column.column);
+			section_header.count = column.count;
+			section_header.offset = offset;
+
+			output.write(reinterpret_cast<const char *>(&section_header), sizeof(section_header));
+
+			offset = aligned(offset + column.count * section_header.element_size);
+		}
+
+		std::size_t position = sizeof(FileHeader) + sizeof(SectionHeader) * columns.size();
+		const char padding[SECTION_ALIGNMENT] = {0};
+
+		for (auto & column : columns) {
+			output.write(padding, aligned(position) - position);
+			position = aligned(position);
+
+			std::size_t size = column.count * element_size(column.column);
+
+			if (column.data) {
+				output.write(reinterpret_cast<const char *>(column.data), size);
+			} else {
+				for (auto & buffer : frame_buffers)
+					if (buffer)
+						output.write(reinterpret_cast<const char *>(buffer->begin()), buffer->size());
+			}
+
+			position += size;
+		}
+	}
+
+	void Dataset::convert(Ptr<ILoader> loader, std::ostream & output, bool include_frames)
+	{
+		Ref<SensorData> sensor_data = new SensorData(loader);
+
+		FrameDataCallbackT frame_data;
+
+		if (include_frames) {
+			frame_data = [&](std::size_t frame_index) -> Shared<Buffer> {
+				Ref<IData> data = loader->data_for_resource(to_string(frame_index));
+
+				return data ? data->buffer() : nullptr;
+			};
+		}
+
+		write(output, sensor_data->sensor_updates(), frame_data);
+	}
+}
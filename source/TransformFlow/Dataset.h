@@ -0,0 +1,145 @@
+//
+//  Dataset.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_DATASET_H
+#define TRANSFORMFLOW_DATASET_H
+
+#include "MotionModel.h"
+
+#include <Dream/Core/Buffer.h>
+#include <Dream/Resources/Loader.h>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+namespace TransformFlow
+{
+	using Resources::ILoader;
+
+	/*
+		A binary version of the CSV log and frame images, which can be memory mapped and read without parsing. The file is a header, a directory of sections, and the sections themselves, each aligned to 8 bytes. Each section is a column of fixed size values, e.g. the time of every motion update. Values are stored in the byte order of the machine that wrote the file, which is checked when it's opened.
+
+		The order of the updates is kept by the EVENTS column, which has the kind of each update. The i-th motion event is row i of the motion columns, and so on.
+
+		Frame images are optional. If present, FRAME_DATA contains the original encoded images (e.g. PNG) one after another, and FRAME_OFFSETS has the start of each one, followed by the end of the last one.
+	 */
+	class Dataset : public Object
+	{
+	public:
+		// The name of the resource which SensorData uses in preference to the CSV log.
+		static const char * RESOURCE_NAME;
+
+		static const std::uint32_t VERSION = 1;
+
+		enum class Event : std::uint8_t {
+			MOTION = 0,
+			LOCATION = 1,
+			HEADING = 2,
+			FRAME = 3,
+		};
+
+		enum class Column : std::uint32_t {
+			// Event:
+			EVENTS = 1,
+
+			// double, float[3], float[3], float[3]:
+			MOTION_TIME = 10,
+			MOTION_ROTATION_RATE = 11,
+			MOTION_ACCELERATION = 12,
+			MOTION_GRAVITY = 13,
+
+			// double:
+			LOCATION_TIME = 20,
+			LOCATION_LATITUDE = 21,
+			LOCATION_LONGITUDE = 22,
+			LOCATION_ALTITUDE = 23,
+			LOCATION_HORIZONTAL_ACCURACY = 24,
+			LOCATION_VERTICAL_ACCURACY = 25,
+
+			// double:
+			HEADING_TIME = 30,
+			HEADING_MAGNETIC_BEARING = 31,
+			HEADING_TRUE_BEARING = 32,
+
+			// double, std::uint64_t, float (radians), std::uint64_t, bytes:
+			FRAME_TIME = 40,
+			FRAME_INDEX = 41,
+			FRAME_FIELD_OF_VIEW = 42,
+			FRAME_OFFSETS = 43,
+			FRAME_DATA = 44,
+		};
+
+		// Open a memory mapped data set, which is kept until this is released. Only the header and directory are read, so this takes constant time however many updates there are. The events and frame offsets are checked as they are read, so that a corrupted file is never read outside its columns. Throws std::runtime_error if the data isn't a valid data set.
+		Dataset(Shared<Buffer> buffer);
+
+		// The data must remain valid until this is released.
+		Dataset(const ByteT * data, std::size_t size);
+
+		virtual ~Dataset();
+
+		// The size of the data set in bytes.
+		std::size_t size() const { return _size; }
+
+		std::size_t event_count() const { return _events.count; }
+
+		// The kind of the given event, which must be less than event_count(). Throws std::runtime_error if the kind is unknown.
+		Event event(std::size_t index) const;
+
+		std::size_t motion_count() const { return _motion_time.count; }
+		std::size_t location_count() const { return _location_time.count; }
+		std::size_t heading_count() const { return _heading_time.count; }
+		std::size_t frame_count() const { return _frame_time.count; }
+
+		// Reconstruct the updates from row index of the respective columns. Throws std::runtime_error if there is no such row, e.g. if the events refer to more rows than the file has:
+		MotionUpdate motion_update(std::size_t index) const;
+		LocationUpdate location_update(std::size_t index) const;
+		HeadingUpdate heading_update(std::size_t index) const;
+
+		// The image is not loaded.
+		ImageUpdate image_update(std::size_t index) const;
+
+		bool has_frame_data() const { return _frame_offsets.count > 0; }
+
+		// Decode the image stored for the given frame row, or return null if it wasn't stored. Throws std::runtime_error if there is no such row, or the image is outside the frame data.
+		Ref<Image> load_frame(std::size_t index) const;
+
+		// Returns the encoded image for the given frame index, or a null buffer if it shouldn't be stored.
+		typedef std::function<Shared<Buffer>(std::size_t frame_index)> FrameDataCallbackT;
+
+		// Write sensor updates in this format.
+		static void write(std::ostream & output, const std::vector<Shared<SensorUpdate>> & sensor_updates, FrameDataCallbackT frame_data = nullptr);
+
+		// Convert a data set in the CSV log and PNG format, which is loaded from the given loader. If include_frames is true, the images are copied into the output without decoding them.
+		static void convert(Ptr<ILoader> loader, std::ostream & output, bool include_frames = true);
+
+	protected:
+		Shared<Buffer> _buffer;
+
+		const ByteT * _data;
+		std::size_t _size;
+
+		struct Section
+		{
+			const ByteT * data = nullptr;
+			std::size_t count = 0;
+		};
+
+		template <typename ValueT>
+		static const ValueT * column(const Section & section) { return reinterpret_cast<const ValueT *>(section.data); }
+
+		static void check_row(const Section & section, std::size_t index);
+
+		Section _events;
+		Section _motion_time, _motion_rotation_rate, _motion_acceleration, _motion_gravity;
+		Section _location_time, _location_latitude, _location_longitude, _location_altitude, _location_horizontal_accuracy, _location_vertical_accuracy;
+		Section _heading_time, _heading_magnetic_bearing, _heading_true_bearing;
+		Section _frame_time, _frame_index, _frame_field_of_view, _frame_offsets, _frame_data;
+
+		void read_directory();
+	};
+}
+
+#endif
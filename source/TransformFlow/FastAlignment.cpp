@@ -10,6 +10,9 @@
 
 #include <iostream>
 #include <cmath>
+#include <complex>
+#include <algorithm>
+#include <functional>
 #include <vector>
 #include <queue>
 #include <random>
@@ -64,8 +67,42 @@ namespace TransformFlow
 		return (difference * difference) / 2.0;
 	}
 
-	template <typename SequenceT>
-	static Cost calculate_alignment_cost(const SequenceT & u, const SequenceT & v, int offset, int estimate, float best_error)
+	typedef std::complex<double> ComplexT;
+
+	// Scratch memory for alignment, which is retained between calls so that steady state alignment doesn't allocate.
+	struct AlignmentWorkspace
+	{
+		// Prefix sums of the squared bin counts, i.e. u_squares[i] = sum(u[k]^2) for k < i:
+		std::vector<std::uint64_t> u_squares, v_squares;
+
+		// Used by the correlation engine:
+		std::vector<ComplexT> signal, twiddles;
+
+		// Used by the best-first engine:
+		std::vector<std::size_t> peaks;
+		std::vector<Cost> costs;
+	};
+
+	static AlignmentWorkspace & alignment_workspace()
+	{
+		static thread_local AlignmentWorkspace workspace;
+
+		return workspace;
+	}
+
+	static void prefix_squares(const HistogramT & u, std::vector<std::uint64_t> & squares)
+	{
+		squares.resize(u.size() + 1);
+		squares[0] = 0;
+
+		for (std::size_t i = 0; i < u.size(); i += 1)
+			squares[i+1] = squares[i] + std::uint64_t(u[i]) * u[i];
+	}
+
+	// Bins are compared in blocks of this size between checks against the best error:
+	static const std::size_t ALIGNMENT_BLOCK_SIZE = 64;
+
+	static Cost calculate_alignment_cost(const HistogramT & u, const HistogramT & v, const AlignmentWorkspace & workspace, int offset, int estimate, float best_error)
 	{
 		Cost cost = {offset};
 
@@ -78,72 +115,258 @@ namespace TransformFlow
 
 		cost.error += error_bias(offset - estimate);
 
-		while (i < u.size() && j < v.size())
-		{
-			auto d = float(u[i]) - float(v[j]);
+		if (i >= u.size() || j >= v.size())
+			return cost;
 
-			cost.add_error(d*d);
+		std::size_t count = std::min(u.size() - i, v.size() - j);
 
-			i += 1, j += 1;
+		// By the triangle inequality, |u - v| >= ||u| - |v||, which gives a lower bound on the SSD from the prefix sums without comparing any bins. A small margin allows for rounding, as costs are always multiples of 0.5:
+		double u_length = std::sqrt(double(workspace.u_squares[i + count] - workspace.u_squares[i]));
+		double v_length = std::sqrt(double(workspace.v_squares[j + count] - workspace.v_squares[j]));
 
-			cost.count += 1;
+		if (cost.error + (u_length - v_length) * (u_length - v_length) > best_error + 0.25) {
+			cost.error = std::numeric_limits<float>::infinity();
 
-			if (cost.error > best_error) break;
+			return cost;
 		}
 
+		std::uint64_t sum = 0;
+
+		while (cost.count < count) {
+			std::size_t block = std::min(count - cost.count, ALIGNMENT_BLOCK_SIZE);
+
+			sum += sum_squared_differences(u.data() + i + cost.count, v.data() + j + cost.count, block);
+			cost.count += block;
+
+			if (cost.error + sum > best_error) break;
+		}
+
+		cost.add_error(sum);
+
 		return cost;
 	}
 
-	template <typename SequenceT>
-	Cost align_small(const SequenceT & u, const SequenceT & v, int estimate)
+	// Evaluates offsets outwards from the estimate, returning the one with the lowest cost. Ties are resolved in favour of the offset evaluated last. The cost function is given the best error so far, so that it can stop early, and offsets which can't be better than the best so far are skipped entirely.
+	template <typename CostFunctionT>
+	static Cost search_offsets(int left_bound, int right_bound, int estimate, CostFunctionT && calculate_cost)
 	{
-		Cost minimum_cost = calculate_alignment_cost(u, v, estimate, estimate, std::numeric_limits<float>::max());
+		Cost minimum_cost = calculate_cost(estimate, std::numeric_limits<float>::max());
 
-		// Used to control expansion of the search space:
+		// Used to control expansion of the search space, which is limited to (left_bound, right_bound):
 		int left = estimate - 1;
 		int right = estimate + 1;
 
-		// The bounds of the offset search:
-		int right_bound = (int)u.size() / 2;
-		int left_bound = -right_bound;
-
 		while (left > left_bound || right < right_bound) {
 			if (left > left_bound) {
-				Cost cost = calculate_alignment_cost(u, v, left, estimate, minimum_cost.error);
+				// The bias only increases away from the estimate, so once it alone exceeds the best cost, no offset further in this direction can be better:
+				if (error_bias(left - estimate) > minimum_cost.error) {
+					left = left_bound;
+				} else {
+					Cost cost = calculate_cost(left, minimum_cost.error);
 
-				if (cost.error <= minimum_cost.error)
-					minimum_cost = cost;
+					if (cost.error <= minimum_cost.error)
+						minimum_cost = cost;
 
-				left -= 1;
+					left -= 1;
+				}
 			}
 
 			if (right < right_bound) {
-				Cost cost = calculate_alignment_cost(u, v, right, estimate, minimum_cost.error);
+				if (error_bias(right - estimate) > minimum_cost.error) {
+					right = right_bound;
+				} else {
+					Cost cost = calculate_cost(right, minimum_cost.error);
 
-				if (cost.error <= minimum_cost.error)
-					minimum_cost = cost;
+					if (cost.error <= minimum_cost.error)
+						minimum_cost = cost;
 
-				right += 1;
+					right += 1;
+				}
 			}
 		}
 
 		return minimum_cost;
 	}
 
-	// Given a list, return the permutation which if applied would sort the list.
+	Cost align_small(const HistogramT & u, const HistogramT & v, int estimate)
+	{
+		auto & workspace = alignment_workspace();
+
+		prefix_squares(u, workspace.u_squares);
+		prefix_squares(v, workspace.v_squares);
+
+		// The bounds of the offset search:
+		int right_bound = (int)u.size() / 2;
+
+		return search_offsets(-right_bound, right_bound, estimate, [&](int offset, float best_error) {
+			return calculate_alignment_cost(u, v, workspace, offset, estimate, best_error);
+		});
+	}
+
+	// Search only the offsets within the given radius of the centre, biased towards the estimate, which may be elsewhere. The window is clamped to the offsets align_small would consider.
+	Cost align_window(const HistogramT & u, const HistogramT & v, int centre, int radius, int estimate)
+	{
+		auto & workspace = alignment_workspace();
+
+		prefix_squares(u, workspace.u_squares);
+		prefix_squares(v, workspace.v_squares);
+
+		// The same exclusive bounds as align_small:
+		int right_bound = (int)u.size() / 2;
+		int left_bound = -right_bound;
+
+		int first = std::max(centre - radius, left_bound + 1);
+		int last = std::min(centre + radius, right_bound - 1);
+
+		// If the window is entirely outside the bounds, only the nearest valid offset is evaluated:
+		if (first > last)
+			first = last = std::min(std::max(centre, left_bound + 1), right_bound - 1);
+
+		Cost minimum_cost = calculate_alignment_cost(u, v, workspace, first, estimate, std::numeric_limits<float>::max());
+
+		for (int offset = first + 1; offset <= last; offset += 1) {
+			Cost cost = calculate_alignment_cost(u, v, workspace, offset, estimate, minimum_cost.error);
+
+			if (cost.error < minimum_cost.error)
+				minimum_cost = cost;
+		}
+
+		return minimum_cost;
+	}
+
+	// In-place iterative radix-2 FFT. The size of the data must be a power of two, and twiddles[k] = exp(-2*pi*i*k/size) for k < size/2.
+	static void fft(std::vector<ComplexT> & data, const std::vector<ComplexT> & twiddles, bool inverse)
+	{
+		const std::size_t size = data.size();
+
+		// Bit reversal permutation:
+		for (std::size_t i = 1, j = 0; i < size; i += 1) {
+			std::size_t bit = size >> 1;
+
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+
+			j ^= bit;
+
+			if (i < j)
+				std::swap(data[i], data[j]);
+		}
+
+		for (std::size_t length = 2; length <= size; length <<= 1) {
+			const std::size_t half = length / 2, stride = size / length;
+
+			for (std::size_t start = 0; start < size; start += length) {
+				for (std::size_t k = 0; k < half; k += 1) {
+					const ComplexT & twiddle = twiddles[k * stride];
+					double wr = twiddle.real(), wi = inverse ? -twiddle.imag() : twiddle.imag();
+
+					ComplexT & a = data[start + k];
+					ComplexT & b = data[start + k + half];
+
+					// Written out by hand, as std::complex multiplication has to handle infinities and can be very slow:
+					double tr = b.real() * wr - b.imag() * wi;
+					double ti = b.real() * wi + b.imag() * wr;
+
+					b = ComplexT(a.real() - tr, a.imag() - ti);
+					a = ComplexT(a.real() + tr, a.imag() + ti);
+				}
+			}
+		}
+	}
+
+	// Computes the same result as align_small, but the SSD of every offset is calculated at once: SSD(offset) = sum(u^2) + sum(v^2) - 2 * sum(u * v) over the overlapping bins. The squares come from prefix sums, and the cross-correlation from a single complex FFT of both (real) histograms. O(n log n) rather than O(n^2).
+	Cost align_correlation(const HistogramT & u, const HistogramT & v, int estimate)
+	{
+		auto & workspace = alignment_workspace();
+
+		const int u_size = u.size(), v_size = v.size();
+
+		// The correlation is circular, so it must be padded to avoid wrapping around:
+		std::size_t size = 1;
+		while (size < u.size() + v.size())
+			size <<= 1;
+
+		auto & signal = workspace.signal;
+		auto & twiddles = workspace.twiddles;
+
+		if (twiddles.size() != size / 2) {
+			twiddles.resize(size / 2);
+
+			for (std::size_t k = 0; k < twiddles.size(); k += 1)
+				twiddles[k] = std::polar(1.0, -2.0 * M_PI * k / size);
+		}
+
+		// Pack both histograms into one complex signal, z = u + iv:
+		signal.assign(size, 0);
+
+		for (std::size_t i = 0; i < u.size(); i += 1)
+			signal[i].real(u[i]);
+
+		for (std::size_t j = 0; j < v.size(); j += 1)
+			signal[j].imag(v[j]);
+
+		fft(signal, twiddles, false);
+
+		// Separate the spectra using their conjugate symmetry and compute U[k] * conj(V[k]) in place. Each pair k, -k is updated together:
+		for (std::size_t k = 0; k <= size / 2; k += 1) {
+			std::size_t l = (size - k) & (size - 1);
+
+			ComplexT zk = signal[k], zl = signal[l];
+
+			// U[k] = (zk + conj(zl)) / 2, V[k] = (zk - conj(zl)) / 2i:
+			double ur = (zk.real() + zl.real()) * 0.5, ui = (zk.imag() - zl.imag()) * 0.5;
+			double vr = (zk.imag() + zl.imag()) * 0.5, vi = (zl.real() - zk.real()) * 0.5;
+
+			// U[k] * conj(V[k]), and U[-k] * conj(V[-k]) which is its conjugate:
+			ComplexT product(ur * vr + ui * vi, ui * vr - ur * vi);
+
+			signal[k] = product;
+			signal[l] = std::conj(product);
+		}
+
+		// The inverse gives sum(u[i + offset] * v[i]) at index offset (mod size):
+		fft(signal, twiddles, true);
+
+		auto & u_squares = workspace.u_squares;
+		auto & v_squares = workspace.v_squares;
+
+		prefix_squares(u, u_squares);
+		prefix_squares(v, v_squares);
+
+		int right_bound = u_size / 2;
+
+		return search_offsets(-right_bound, right_bound, estimate, [&](int offset, float) {
+			Cost cost = {offset};
+
+			cost.error += error_bias(offset - estimate);
+
+			// The same overlap as calculate_alignment_cost, u[i] is compared with v[i - offset]:
+			int i = std::max(offset, 0), end = std::min(u_size, v_size + offset);
+
+			if (i < end) {
+				double cross = signal[offset & (size - 1)].real() / size;
+				double squares = (u_squares[end] - u_squares[i]) + (v_squares[end - offset] - v_squares[i - offset]);
+
+				// The histograms are integers, so rounding recovers the exact SSD:
+				cost.add_error(std::round(squares - 2.0 * cross));
+				cost.count = end - i;
+			}
+
+			return cost;
+		});
+	}
+
+	// Given a list, compute the permutation which if applied would sort the list.
 	template <class SequenceT, typename CompareT = std::less<typename SequenceT::value_type>>
-	std::vector<std::size_t> permutation(const SequenceT & values, const CompareT & compare = CompareT()) {
-		std::vector<std::size_t> indices;
-		indices.reserve(values.size());
+	void permutation(const SequenceT & values, std::vector<std::size_t> & indices, const CompareT & compare = CompareT()) {
+		indices.resize(values.size());
 
 		for (std::size_t i = 0; i < values.size(); i += 1)
-			indices.push_back(i);
+			indices[i] = i;
 
 		std::sort(std::begin(indices), std::end(indices), [&](std::size_t a, std::size_t b) -> bool {
 			return compare(values[a], values[b]);
 		});
-
-		return indices;
 	}
 
 	template <typename HeapT, typename CompareT = std::less<typename HeapT::value_type>>
@@ -204,93 +427,148 @@ namespace TransformFlow
 			heap.at(child_index) = item;
 	}
 
-	template <typename SequenceT>
-	Cost align_large(const SequenceT & u, const SequenceT & v, int estimate)
+	// The best-first search compares this many peaks between updates of the heap:
+	static const std::size_t ALIGNMENT_PEAKS_BLOCK_SIZE = 16;
+
+	// The position of the offset in the order search_offsets evaluates offsets: estimate, estimate - 1, estimate + 1, estimate - 2, ...
+	static int search_order(int offset, int estimate)
 	{
-		auto peaks = permutation(u, std::greater<std::size_t>());
+		int distance = offset - estimate;
 
-		std::vector<Cost> costs;
+		return distance < 0 ? -2 * distance - 1 : 2 * distance;
+	}
+
+	// A best-first search over offsets. Each entry in the heap is a partially evaluated offset whose error is a lower bound on its final cost. The best entry is extended a block of bins at a time, comparing the largest peaks of u first, so that poor offsets quickly fall behind. The first offset to be completely evaluated while at the top of the heap is the best. Offsets are only added to the heap once their neighbour closer to the estimate has reached the top, as the bias increases away from the estimate. Gives the same result as align_small.
+	Cost align_large(const HistogramT & u, const HistogramT & v, int estimate)
+	{
+		auto & workspace = alignment_workspace();
+		auto & peaks = workspace.peaks;
+		auto & costs = workspace.costs;
+
+		permutation(u, peaks, std::greater<std::uint16_t>());
+
+		// Equal costs are resolved in the same way as search_offsets, in favour of the offset evaluated last:
+		auto compare = [&](const Cost & a, const Cost & b) {
+			if (a.error != b.error)
+				return a.error < b.error;
+
+			return search_order(a.offset, estimate) > search_order(b.offset, estimate);
+		};
 
 		// Used to control expansion of the search space:
 		int left = estimate - 1;
 		int right = estimate + 1;
 
-		// The bounds of the offset search:
-		int right_bound = int(u.size() / 4) * 3;
+		// The bounds of the offset search, the same as search_offsets:
+		int right_bound = (int)u.size() / 2;
 		int left_bound = -right_bound;
 
-		// Avoid reallocation:
-		costs.reserve(std::max(u.size(), v.size()) + std::min(u.size(), v.size()) * 2);
-		costs.push_back({estimate});
+		costs.clear();
+		costs.push_back({estimate, error_bias(0)});
 
-		while (costs.size() > 0) {
-			auto & best = costs.front();
+		while (true) {
+			if (costs.front().count == 0) {
+				int offset = costs.front().offset;
 
-			if (best.count == 0) {
-				// Add adjacent costs if required.
-				if ((left == best.offset-1) && (left > left_bound)) {
+				// Add adjacent costs if required. They have a larger bias, so the front of the heap doesn't change:
+				if ((left == offset-1) && (left > left_bound)) {
 					costs.push_back({left, error_bias(left - estimate)});
-					siftup(costs, costs.size() - 1);
+					siftup(costs, costs.size() - 1, compare);
 					left -= 1;
 				}
 
-				if ((right == best.offset+1) && (right < right_bound)) {
+				if ((right == offset+1) && (right < right_bound)) {
 					costs.push_back({right, error_bias(right - estimate)});
-					siftup(costs, costs.size() - 1);
+					siftup(costs, costs.size() - 1, compare);
 					right += 1;
 				}
-			} else {
-				// If we have evaluated all items and this is still the lowest cost, we are done:
-				if (best.count >= u.size())
-					return best;
 			}
 
-			auto i = best.count;
-			auto j = peaks.at(i);
+			auto & best = costs.front();
+
+			// If we have evaluated all items and this is still the lowest cost, we are done:
+			if (best.count >= u.size())
+				return best;
 
-			auto k = int(j) - best.offset;
+			// Extend the best offset by a block of peaks at a time, to reduce the number of heap operations:
+			std::size_t last = std::min(best.count + ALIGNMENT_PEAKS_BLOCK_SIZE, u.size());
+			float error = best.error;
 
-			best.count += 1;
+			for (; best.count < last; best.count += 1) {
+				auto j = peaks[best.count];
+				auto k = int(j) - best.offset;
 
-			if (k >= 0 && k < v.size()) {
-				auto d = float(u[j]) - float(v[k]);
+				if (k >= 0 && k < int(v.size())) {
+					auto d = float(u[j]) - float(v[k]);
 
-				if (d != 0) {
 					best.add_error(d*d);
-					siftdown(costs, 0);
 				}
 			}
+
+			if (best.error != error)
+				siftdown(costs, 0, compare);
 		}
+	}
+
+	// Histograms with at least this many bins are aligned using the correlation engine. See the "Benchmark Alignment Engines" test.
+	const std::size_t CORRELATION_ENGINE_THRESHOLD = 2048;
 
-		// Never get here:
-		return {estimate};
+	static Cost align_sequences(const HistogramT & u, const HistogramT & v, int estimate, AlignmentEngine engine)
+	{
+		if (engine == AlignmentEngine::AUTOMATIC)
+			engine = std::max(u.size(), v.size()) >= CORRELATION_ENGINE_THRESHOLD ? AlignmentEngine::CORRELATION : AlignmentEngine::SEARCH;
+
+		switch (engine) {
+			case AlignmentEngine::CORRELATION:
+				return align_correlation(u, v, estimate);
+			case AlignmentEngine::BEST_FIRST:
+				return align_large(u, v, estimate);
+			default:
+				return align_small(u, v, estimate);
+		}
 	}
 
-	typedef std::vector<std::size_t> UnsignedSequenceT;
+	int align_histograms(const HistogramT & u, const HistogramT & v, int estimate, AlignmentEngine engine)
+	{
+		return align_sequences(u, v, estimate, engine).offset;
+	}
+
+	// When refining the offset from a coarser level of the pyramid, search this many bins either side of it:
+	static const int PYRAMID_SEARCH_RADIUS = 3;
 
-	Average<RealT> align_tables(const FeatureTable & a, const FeatureTable & b, int estimate)
+	// The estimate in bins at the given level of the pyramid.
+	static int pyramid_estimate(int estimate, std::size_t level)
 	{
-		UnsignedSequenceT sa, sb;
+		return int(std::round(RealT(estimate) / (1 << level)));
+	}
 
-		//std::cerr << "a.bins: ";
-		for (auto & bin : a.bins()) {
-		//	std::cerr << bin.links.size() << " ";
-			sa.push_back(bin.features.size());
-		}
-		//std::cerr << std::endl;
+	// Search the coarsest level fully, then refine the offset at each finer level within a small window. Each level combines pairs of bins from the one below, starting from the first bin, so an offset at one level corresponds to twice that offset at the level below. Every level is biased towards the original estimate, so at the finest level the cost of each offset is the same as for a full search.
+	static Cost align_pyramid(const FeatureTable & a, const FeatureTable & b, int estimate, AlignmentEngine engine)
+	{
+		std::size_t level = FeatureTable::HISTOGRAM_LEVELS - 1;
+
+		Cost cost = align_sequences(a.histogram(level), b.histogram(level), pyramid_estimate(estimate, level), engine);
 
-		//std::cerr << "b.bins: ";
-		for (auto & bin : b.bins()) {
-		//	std::cerr << bin.links.size() << " ";
-			sb.push_back(bin.features.size());
+		while (level > 0) {
+			level -= 1;
+
+			cost = align_window(a.histogram(level), b.histogram(level), cost.offset * 2, PYRAMID_SEARCH_RADIUS, pyramid_estimate(estimate, level));
 		}
-		//std::cerr << std::endl;
+
+		return cost;
+	}
+
+	Average<RealT> align_tables(const FeatureTable & a, const FeatureTable & b, int estimate, AlignmentEngine engine, AlignmentSearch search)
+	{
+		// The histograms are maintained by the tables, so no copying is required:
+		auto & sa = a.histogram();
+		auto & sb = b.histogram();
 
 		// The origin of sa, sb is in the middle. So, we need to bias the search to take this into account:
 		int bias = (int(sa.size()) - int(sb.size())) / 2;
 
 		// Most likely bin offset:
-		Cost cost = align_small(sa, sb, bias + estimate);
+		Cost cost = search == AlignmentSearch::PYRAMID ? align_pyramid(a, b, bias + estimate, engine) : align_sequences(sa, sb, bias + estimate, engine);
 
 		auto offset = cost.offset;
 
@@ -299,18 +577,18 @@ namespace TransformFlow
 			log_debug("align", "sa", sa.size(), "sb", sb.size(), "estimate", estimate, "bias", bias, "cost offset", cost.offset, "error", cost.error);
 
 			std::cerr << "a.bins: ";
-			for (auto & bin : a.bins()) {
-				std::cerr << bin.links.size() << " ";
+			for (auto count : sa) {
+				std::cerr << count << " ";
 			}
 			std::cerr << std::endl;
 
 			std::cerr << "b.bins: ";
-			for (auto & bin : b.bins()) {
-				std::cerr << bin.links.size() << " ";
+			for (auto count : sb) {
+				std::cerr << count << " ";
 			}
 			std::cerr << std::endl;
 
-			cost = align_small(sa, sb, bias + estimate);
+			cost = search == AlignmentSearch::PYRAMID ? align_pyramid(a, b, bias + estimate, engine) : align_sequences(sa, sb, bias + estimate, engine);
 		}
 #endif
 
@@ -323,7 +601,7 @@ namespace TransformFlow
 		else
 			i = offset;
 
-		while (i < a.bins().size() && j < b.bins().size())
+		while (i < a.bin_count() && j < b.bin_count())
 		{
 			auto bin_alignment = a.bin_alignment_average(b, i, j);
 
@@ -18,7 +18,35 @@ namespace TransformFlow
 	using namespace Euclid::Numerics;
 	using namespace TransformFlow;
 
-	Average<RealT> align_tables(const FeatureTable & a, const FeatureTable & b, int estimate = 0);
+	enum class AlignmentEngine {
+		// Choose an engine based on the number of bins:
+		AUTOMATIC,
+
+		// Evaluate offsets outwards from the estimate, stopping each one early once it's worse than the best so far. O(n^2) in the worst case, but fast for small histograms.
+		SEARCH,
+
+		// Compute the cost of all offsets at once using FFT cross-correlation. O(n log n).
+		CORRELATION,
+
+		// Evaluate the most promising offset a few bins at a time, comparing the largest bins first. In the "Benchmark Alignment Engines" test it is slower than the search engine at every size from 100 to 10000 bins, so it is never selected automatically.
+		BEST_FIRST,
+	};
+
+	// Histograms with at least this many bins use the correlation engine by default.
+	extern const std::size_t CORRELATION_ENGINE_THRESHOLD;
+
+	// The offset which best aligns the histograms, such that u[i] corresponds to v[i - offset], biased towards the estimate. Both engines give the same result.
+	int align_histograms(const HistogramT & u, const HistogramT & v, int estimate, AlignmentEngine engine = AlignmentEngine::AUTOMATIC);
+
+	enum class AlignmentSearch {
+		// Search every offset up to half the number of bins either side of the estimate.
+		FULL,
+
+		// Search the coarsest level of the histogram pyramid fully, then refine the offset within a few bins at each finer level. The cost stays close to logarithmic in the number of bins even when the estimate is poor. Usually gives the same offset as FULL, but can settle on a different minimum when the overlap is small and the coarse histograms have little structure, so it must be requested explicitly.
+		PYRAMID,
+	};
+
+	Average<RealT> align_tables(const FeatureTable & a, const FeatureTable & b, int estimate = 0, AlignmentEngine engine = AlignmentEngine::AUTOMATIC, AlignmentSearch search = AlignmentSearch::FULL);
 }
 
 #endif /* defined(__IntegerArrayAlignment__Alignment__) */
@@ -7,10 +7,13 @@
 //
 
 #include "FeatureAlgorithm.h"
+#include "LuminanceCache.h"
 
 #include <Dream/Events/Logger.h>
 #include <Euclid/Numerics/Matrix.IO.h>
 
+#include <stdexcept>
+
 namespace TransformFlow {
 	using namespace Dream::Events::Logging;
 
@@ -30,23 +33,46 @@ namespace TransformFlow {
 		_matcher->match(query, train, matches);
 	}
 
-	static void convert_to_greyscale(Ref<Image> pixel_buffer, cv::Mat & output) {
-		Vec3u size = pixel_buffer->size();
-		
-		cv::Mat color_frame(size[Y], size[X], CV_8UC3, (void*)pixel_buffer->data());
+	void convert_to_greyscale(const PixelPlane & plane, cv::Mat & output) {
+		void * data = const_cast<ByteT *>(plane.data);
+
+		switch (plane.channels) {
+			case 1:
+				// Already greyscale, so we can use the pixel data directly:
+				output = cv::Mat(plane.height, plane.width, CV_8UC1, data, plane.stride);
+				break;
+
+			case 2:
+				cv::extractChannel(cv::Mat(plane.height, plane.width, CV_8UC2, data, plane.stride), output, 0);
+				break;
+
+			case 3:
+				cv::cvtColor(cv::Mat(plane.height, plane.width, CV_8UC3, data, plane.stride), output, CV_RGB2GRAY);
+				break;
+
+			case 4:
+				cv::cvtColor(cv::Mat(plane.height, plane.width, CV_8UC4, data, plane.stride), output, CV_RGBA2GRAY);
+				break;
 
-		output = cv::Mat(size[Y], size[X], CV_8UC1);
-		cv::cvtColor(color_frame, output, CV_RGB2GRAY);
+			default:
+				throw std::invalid_argument("Unsupported pixel layout!");
+		}
+	}
+
+	void convert_to_greyscale(Ptr<Image> pixel_buffer, cv::Mat & output) {
+		convert_to_greyscale(PixelPlane::for_image(pixel_buffer), output);
 	}
 
 	Vec2 MatchingAlgorithm::calculate_local_translation(const ImageUpdate & initial, const ImageUpdate & next) {
-		Vec3u size = initial.image_buffer->size();
+		Ref<Image> initial_image = initial.image(), next_image = next.image();
+
+		Vec3u size = initial_image->size();
 
-		assert(initial.image_buffer->layout().channel_count() == 3);
-		assert(next.image_buffer->layout().channel_count() == 3);
+		assert(initial_image->layout().channel_count() == 3);
+		assert(next_image->layout().channel_count() == 3);
 
-		cv::Mat initial_frame(size[Y], size[X], CV_8UC3, (void*)initial.image_buffer->data());
-		cv::Mat next_frame(size[Y], size[X], CV_8UC3, (void*)next.image_buffer->data());
+		cv::Mat initial_frame(size[Y], size[X], CV_8UC3, (void*)initial_image->data());
+		cv::Mat next_frame(size[Y], size[X], CV_8UC3, (void*)next_image->data());
 
 		std::clock_t start_time = std::clock();
 		std::vector<cv::KeyPoint> initial_keypoints;
@@ -83,10 +109,11 @@ namespace TransformFlow {
 	}
 
 	Mat44 MatchingAlgorithm::calculate_local_transform(const ImageUpdate & initial, const ImageUpdate & next) {
-		cv::Mat initial_frame, next_frame;
+		// The luminance is cached, so the next image will not be converted again when it becomes the initial image:
+		Ref<Luminance> initial_luminance = initial.luminance(), next_luminance = next.luminance();
 
-		convert_to_greyscale(initial.image_buffer, initial_frame);
-		convert_to_greyscale(next.image_buffer, next_frame);
+		const cv::Mat & initial_frame = initial_luminance->pixels();
+		const cv::Mat & next_frame = next_luminance->pixels();
 
 		std::vector<cv::KeyPoint> initial_keypoints, next_keypoints;
 		detect_features(initial_frame, initial_keypoints);
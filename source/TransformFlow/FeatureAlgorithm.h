@@ -17,6 +17,7 @@
 
 #include <Dream/Class.h>
 #include "VideoStream.h"
+#include "PixelPlane.h"
 
 namespace TransformFlow {
 	class MatchingAlgorithm : public Object {
@@ -46,6 +47,10 @@ namespace TransformFlow {
 	};
 
 	Ref<MatchingAlgorithm> matchingAlgorithmUsingORB();
+
+	// Converts any supported pixel layout to an 8-bit greyscale matrix. Greyscale planes (e.g. the luma plane of a camera frame) are wrapped without copying, so the output is only valid while the plane is. Throws std::invalid_argument for other channel counts.
+	void convert_to_greyscale(const PixelPlane & plane, cv::Mat & output);
+	void convert_to_greyscale(Ptr<Image> pixel_buffer, cv::Mat & output);
 }
 
 #endif /* defined(__Transform_Flow__FeatureAlgorithm__) */
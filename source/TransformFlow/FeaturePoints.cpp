@@ -7,8 +7,13 @@
 //
 
 #include "FeaturePoints.h"
+
 #include <Dream/Events/Logger.h>
 #include <Euclid/Geometry/AlignedBox.h>
+#include <Euclid/Numerics/Interpolate.h>
+
+#include <algorithm>
+#include <cassert>
 
 namespace TransformFlow {
 	
@@ -93,197 +98,166 @@ namespace TransformFlow {
 		}
 	}
 
-	template <typename NumericT, std::size_t H = 5>
-	struct LaplacianGradients
-	{
-		inline NumericT laplace(const NumericT values[H], const std::size_t offset)
-		{
-			auto mid = (((H-1)/2 + offset) % H);
-			NumericT sum = values[mid] * (H-1);
+	template <typename PixelT>
+	void FeaturePoints::features_along_line(const PixelPlane & plane, Vec2i start, Vec2i end, ScanlineKernel kernel, Scanline & scanline, std::vector<Vec2> & features) {
+		const int height = plane.height;
 
-			// Subtractions and modulus don't work as you'd expect..
-			mid = mid + H;
+		// We want the algorithm to work with the origin in the bottom left, not the top left.
+		start[Y] = height - start[Y];
+		end[Y] = height - end[Y];
 
-			for (std::size_t i = 1; i <= (H-1)/2; i += 1)
-			{
-				sum += values[(mid-i) % H] * -1;
-				sum += values[(mid+i) % H] * -1;
-			}
+		scanline.intensities.clear();
+		scanline.positions.clear();
+		scanline.edges.clear();
 
-			return sum;
-		}
+		// Sample the entire line first, so that the edge detector can process it in one go:
+		bresenham_normalized_line(start, end, [&](const Vec2i & offset) {
+			RealT intensity = PixelT::intensity(plane.pixel(offset[X], offset[Y]));
 
-		NumericT input[H];
-		std::size_t k = 0;
+			Vec2 image_offset = offset;
+			image_offset[Y] = height - image_offset[Y];
 
-		NumericT output[2];
+			scanline.intensities.push_back(intensity);
+			scanline.positions.push_back(image_offset);
+		});
 
-		template <typename F>
-		inline void sum(const NumericT & value, F callback) {
-			input[k % H] = value;
+		find_edges_along_scanline(scanline.intensities.data(), scanline.intensities.size(), scanline.edges, kernel);
 
-			if (k >= (H-1)) {
-				// Latest measurement is stored in output[1], previous measurement stored in output[0].
-				output[1] = laplace(input, (k - (H-1)) % H);
+		for (auto & edge : scanline.edges) {
+			if (edge.exact) {
+				features.push_back(scanline.positions[edge.index]);
+			} else {
+				features.push_back(linear_interpolate<RealT>(edge.fraction, scanline.positions[edge.index-1], scanline.positions[edge.index]));
+			}
+		}
+	}
 
-				if (k >= H) {
-					callback(k - (H-1)/2);
-				}
+	void FeaturePoints::features_along_row(const AlignedImage & aligned_image, std::size_t index, ScanlineKernel kernel, Scanline & scanline, std::vector<Vec2> & features) {
+		auto & row = aligned_image.rows()[index];
 
-				output[0] = output[1];
-			}
+		scanline.edges.clear();
 
-			k += 1;
+		// The row is already contiguous, so there is nothing to gather:
+		find_edges_along_scanline(aligned_image.row_data(index), row.count, scanline.edges, kernel);
+
+		for (auto & edge : scanline.edges) {
+			if (edge.exact) {
+				features.push_back(row.position(edge.index));
+			} else {
+				features.push_back(row.position((edge.index - 1) + edge.fraction));
+			}
 		}
+	}
+
+	FeaturePoints::FeaturePoints(ScanlineKernel kernel) : _kernel(kernel), _mode(ScanMode::LINES), _pixels_per_bin(2), _scanned(false) {
 		
-		std::size_t index() const
-		{
-			return k % H;
-		}
+	}
+	
+	FeaturePoints::~FeaturePoints() {
 		
-		NumericT & at(std::size_t i) { return input[i % H]; }
-		const NumericT & at(std::size_t i) const { return input[i % H]; }
-
-		RealT variance_min_max(const std::size_t & index) const
-		{
-			RealT min = 255.0, max = 0.0;
+	}
 
-			for (int i = -2; i <= 2; i += 1) {
-				min = std::min(min, at(i+index));
-				max = std::max(max, at(i+index));
+	template <typename PixelT>
+	void FeaturePoints::scan_segments(const PixelPlane & plane, std::size_t first, std::size_t last, Scanline & scanline, std::vector<Vec2> & offsets)
+	{
+		for (std::size_t i = first; i < last; i += 1) {
+			if (_mode == ScanMode::RESAMPLED) {
+				_aligned_image.sample(plane, i);
+				features_along_row(_aligned_image, i, _kernel, scanline, offsets);
+			} else {
+				features_along_line<PixelT>(plane, _segments[i].start(), _segments[i].end(), _kernel, scanline, offsets);
 			}
-
-			return (max - min);
 		}
+	}
 
-		RealT variance_left_right(const std::size_t & index) const
-		{
-			auto ia = (at(index-2) + at(index-1)) / 2.0;
-			auto ib = at(index);
-			auto ic = (at(index+2) + at(index+1)) / 2.0;
-
-			auto dab = (ib - ia), dbc = (ic - ib);
-			auto d = (dab*dab) + (dbc*dbc);
-
-			return d;
+	struct FeaturePoints::SegmentScanner
+	{
+		FeaturePoints * feature_points;
+		const PixelPlane & plane;
+		std::size_t first, last;
+		Scanline & scanline;
+		std::vector<Vec2> & offsets;
+
+		template <typename PixelT>
+		void operator()(PixelT) {
+			feature_points->scan_segments<PixelT>(plane, first, last, scanline, offsets);
 		}
+	};
 
-		RealT variance_min(const std::size_t & index) const
-		{
-			auto ia = (at(index-2) + at(index-1)) / 2.0;
-			auto ic = (at(index+2) + at(index+1)) / 2.0;
+	void FeaturePoints::scan_segments(const PixelPlane & plane, std::size_t first, std::size_t last, Scanline & scanline, std::vector<Vec2> & offsets)
+	{
+		// The pixel layout is resolved once for a batch of segments, so that the per-pixel code is specialised at compile time:
+		bool supported = dispatch_pixel_type(plane, SegmentScanner{this, plane, first, last, scanline, offsets});
 
-			auto dac = (ic - ia);
+		assert(supported && "Unsupported pixel layout!");
+	}
 
-			return fabsf(dac);
-		}
+	void FeaturePoints::scan_segments_parallel(const PixelPlane & plane)
+	{
+		// Split the segments into contiguous chunks, one per thread, including the calling thread:
+		std::size_t chunk_count = std::min(_thread_pool->size() + 1, _segments.size());
+		std::size_t chunk_size = (_segments.size() + chunk_count - 1) / chunk_count;
 
-		RealT variance_edge_to_edge(const std::size_t & index) const
-		{
-			const int K = (H-1) / 2;
+		if (_chunks.size() < chunk_count)
+			_chunks.resize(chunk_count);
 
-			// Normal pixel difference
-			auto ia = at(index-K);
-			auto ic = at(index+K);
+		_thread_pool->parallel_for(chunk_count, [&](std::size_t index) {
+			auto & chunk = _chunks[index];
+			chunk.offsets.clear();
 
-			auto dac = (ic - ia);
+			std::size_t first = index * chunk_size;
+			std::size_t last = std::min(first + chunk_size, _segments.size());
 
-			return fabsf(dac);
-		}
+			scan_segments(plane, first, last, chunk.scanline, chunk.offsets);
+		});
 
-		bool good_edge(const std::size_t & index) const
-		{
-			//return variance_min(index) > 30;
-			//return variance_edge_to_edge(index) > 20;
-			
-			// Found this to be the most robust:
-			return variance_left_right(index) >= 600;
+		// Merge the results in line order, so they are identical to the serial scan:
+		for (std::size_t index = 0; index < chunk_count; index += 1) {
+			auto & offsets = _chunks[index].offsets;
+			_offsets.insert(_offsets.end(), offsets.begin(), offsets.end());
 		}
-	};
-
-	template <typename NumericT>
-	NumericT midpoint(const NumericT & a, const NumericT b)
-	{
-		//return 0.5;
-		return -a / (b-a);
-		//return -b / (a-b);
 	}
 
-	void FeaturePoints::features_along_line(Ptr<Image> image, Vec2i start, Vec2i end, std::vector<Vec2> & features) {
-		//AlignedBox2 image_box = AlignedBox2::from_origin_and_size(ZERO, image->size());
+	void FeaturePoints::reset()
+	{
+		_offsets.clear();
+		_segments.clear();
+		_source = nullptr;
+		_scanned = false;
 
-		// We want the algorithm to work with the origin in the bottom left, not the top left.
-		start[Y] = (int)image->size()[HEIGHT] - start[Y];
-		end[Y] = (int)image->size()[HEIGHT] - end[Y];
+		// The table is reset when it's next used.
+	}
 
-		const std::size_t H = 5;
-		typedef Vector<3, unsigned char> PixelT;
-		LaplacianGradients<RealT, H> gradients;
+	void FeaturePoints::scan(Ptr<Image> source, const Radians<> & tilt, std::size_t dy)
+	{
+		if (_offsets.size()) return;
 		
-		auto image_reader = reader(*image);
-
-		Vec2 offsets[H];
-
-		bresenham_normalized_line(start, end, [&](const Vec2i & offset) {
-			//assert(offset.greater_than_or_equal({0, 0}));
-			//assert(offset.less_than(image->size()));
-
-			RealT intensity = Vec3(PixelT(image_reader[offset])).sum() / 3.0;
-			//log_debug("pixel", Vec3(image_reader[offset]), intensity);
-
-			Vec2 image_offset = offset;
-			image_offset[Y] = image->size()[HEIGHT] - image_offset[Y];
+		_source = source;
 
-			offsets[gradients.index()] = image_offset;
-			
-			gradients.sum(intensity, [&](std::size_t index) {
-				auto & a = gradients.output[0];
-				auto & b = gradients.output[1]; // index
-				//auto d = (b - a);
+		scan(PixelPlane::for_image(source), tilt, dy);
+	}
 
-				// Early break out:
-				//if ((d*d) < 100) return;
+	void FeaturePoints::scan(const ImageUpdate & image_update, const Radians<> & tilt, std::size_t dy)
+	{
+		if (_offsets.size()) return;
 
-				if (a != 0 && b == 0)
-				{
-					if (gradients.good_edge(index) == false) return;
+		_source = image_update.image_buffer;
 
-					//assert(image_box.intersects_with(offsets[index % H]));
-					
-					// Zero crossing at index (very rare).
-					features.push_back(offsets[index % H]);
-				}
-				else if ((a < 0 && b > 0) || (b < 0 && a > 0))
-				{
-					if (gradients.good_edge(index) == false) return;
+		// The kernels average the colour channels themselves, so the image is scanned directly rather than through its cached luminance, which is weighted luma and would detect different edges in colour images:
+		Ref<Image> image = image_update.image();
 
-					// Midpoint between index-1 and index.
-					auto m = linear_interpolate<RealT>(midpoint(a, b), offsets[(index-1) % H], offsets[index % H]);
-					
-					//assert(image_box.intersects_with(m));
-					
-					features.push_back(m);
-				} else {
-					return;
-				}
-			});
-		});
-	}
+		// The image may be missing, e.g. if it wasn't stored in the data set, in which case there are no feature points:
+		if (!image) return;
 
-	FeaturePoints::FeaturePoints() {
-		
-	}
-	
-	FeaturePoints::~FeaturePoints() {
-		
+		scan(PixelPlane::for_image(image), tilt, dy);
 	}
 
-	void FeaturePoints::scan(Ptr<Image> source, const Radians<> & tilt, std::size_t dy)
+	void FeaturePoints::scan(const PixelPlane & plane, const Radians<> & tilt, std::size_t dy)
 	{
 		if (_offsets.size()) return;
-		
-		_source = source;
-		AlignedBox2 image_box(ZERO, _source->size());
+
+		Vec2 size(plane.width, plane.height);
+		AlignedBox2 image_box(ZERO, size);
 
 		{
 			AlignedBox2 bounds = ZERO;
@@ -291,8 +265,6 @@ namespace TransformFlow {
 			// Forward rotation, create a bounding box where -y is "down".
 			Mat22 rotation = rotate<Z>(tilt);
 
-			Vec2 size = _source->size();
-
 			bounds.union_with_point(rotation * size);
 			bounds.union_with_point(rotation * Vec2(size[X], 0));
 			bounds.union_with_point(rotation * Vec2(0, size[Y]));
@@ -323,19 +295,50 @@ namespace TransformFlow {
 					//DREAM_ASSERT(clipped_segment.direction().equivalent(segment.direction()));
 
 					_segments.push_back(clipped_segment);
-
-					Vec2 start = clipped_segment.start();
-					Vec2 end = clipped_segment.end();
-
-					features_along_line(source, start, end, _offsets);
 				}
 			}
 		}
 
-		_table = new FeatureTable(dy, 2, image_box, tilt);
+		// Each row of the aligned image is sampled independently when its segment is scanned:
+		if (_mode == ScanMode::RESAMPLED)
+			_aligned_image.allocate(_segments);
+
+		// Each segment is independent, so they can be processed in parallel as long as the results are merged in order:
+		if (_thread_pool && _segments.size() > 1) {
+			scan_segments_parallel(plane);
+		} else {
+			scan_segments(plane, 0, _segments.size(), _scanline, _offsets);
+		}
+
+		// Reuse the existing table if possible:
+		if (_table)
+			_table->reset(dy, _pixels_per_bin, image_box, tilt);
+		else
+			_table = new FeatureTable(dy, _pixels_per_bin, image_box, tilt);
 
 		_table->update(_offsets);
 
+		_scanned = true;
+
 		//log_debug("Found", _offsets.size(), "feature points.");
 	}
+
+	Ref<FeaturePoints> FeaturePointsPool::acquire()
+	{
+		if (_available.empty())
+			return new FeaturePoints;
+
+		Ref<FeaturePoints> feature_points = _available.back();
+		_available.pop_back();
+
+		feature_points->reset();
+
+		return feature_points;
+	}
+
+	void FeaturePointsPool::release(Ref<FeaturePoints> feature_points)
+	{
+		if (feature_points)
+			_available.push_back(feature_points);
+	}
 }
@@ -15,6 +15,11 @@
 #include <Euclid/Geometry/Line.h>
 
 #include "FeatureTable.h"
+#include "ScanlineKernel.h"
+#include "ThreadPool.h"
+#include "AlignedImage.h"
+#include "PixelPlane.h"
+#include "MotionModel.h"
 
 // Dense optical flow vs Sparse optical flow
 // Look at stereo image processing (correspondence between rectified pairs of images)
@@ -32,27 +37,100 @@ namespace TransformFlow {
 	using namespace Euclid::Geometry;
 	using namespace Dream::Imaging;
 	
+	enum class ScanMode {
+		// Walk each scanline directly in the source image.
+		LINES,
+
+		// Resample the image into contiguous rows perpendicular to gravity, and scan those.
+		RESAMPLED
+	};
+
 	class FeaturePoints : public Object {
 	protected:
 		std::vector<Vec2> _offsets;
 		Ref<FeatureTable> _table;
 		
 		Ref<Image> _source;
+
+		// Working storage for a single scanline, reused between lines to avoid reallocation:
+		struct Scanline {
+			std::vector<RealT> intensities;
+			std::vector<Vec2> positions;
+			std::vector<ScanlineEdge> edges;
+		};
+
+		ScanlineKernel _kernel;
+		Scanline _scanline;
+
+		// Per-thread output used by the parallel scan:
+		struct Chunk {
+			Scanline scanline;
+			std::vector<Vec2> offsets;
+		};
+
+		Ref<ThreadPool> _thread_pool;
+		std::vector<Chunk> _chunks;
 		
-		static void features_along_line(Ptr<Image> image, Vec2i start, Vec2i end, std::vector<Vec2> & features);
+		ScanMode _mode;
+		AlignedImage _aligned_image;
+
+		RealT _pixels_per_bin;
+		bool _scanned;
+		
+		template <typename PixelT>
+		static void features_along_line(const PixelPlane & plane, Vec2i start, Vec2i end, ScanlineKernel kernel, Scanline & scanline, std::vector<Vec2> & features);
+		static void features_along_row(const AlignedImage & aligned_image, std::size_t index, ScanlineKernel kernel, Scanline & scanline, std::vector<Vec2> & features);
+
+		// Scanning is specialised for each pixel layout:
+		struct SegmentScanner;
+
+		template <typename PixelT>
+		void scan_segments(const PixelPlane & plane, std::size_t first, std::size_t last, Scanline & scanline, std::vector<Vec2> & offsets);
+		void scan_segments(const PixelPlane & plane, std::size_t first, std::size_t last, Scanline & scanline, std::vector<Vec2> & offsets);
+		void scan_segments_parallel(const PixelPlane & plane);
 
 		std::vector<LineSegment2> _segments;
 		AlignedBox2 _bounding_box;
 
 	public:		
-		FeaturePoints();
+		FeaturePoints(ScanlineKernel kernel = ScanlineKernel::AUTOMATIC);
 		virtual ~FeaturePoints();
 
-		// dy is the distance between scanlines. estimate is the size of the expected motion blur.
+		ScanlineKernel kernel() const { return _kernel; }
+
+		ScanMode mode() const { return _mode; }
+		void set_mode(ScanMode mode) { _mode = mode; }
+
+		// The width of each bin in the feature table. Tables can only be aligned if they have the same bin width and scanline spacing.
+		RealT pixels_per_bin() const { return _pixels_per_bin; }
+		void set_pixels_per_bin(RealT pixels_per_bin) { _pixels_per_bin = pixels_per_bin; }
+
+		// If a thread pool is provided, scanlines are processed in parallel. The results are identical to the serial scan.
+		Ref<ThreadPool> thread_pool() const { return _thread_pool; }
+		void set_thread_pool(Ref<ThreadPool> thread_pool) { _thread_pool = thread_pool; }
+
+		// Discard the results of the previous scan so that a new image can be scanned. Memory is kept, so after the first few scans, scanning and aligning the table without a thread pool does not allocate. A parallel scan still allocates to dispatch the scanlines, see ThreadPool::parallel_for. The table is reused too, so don't keep a reference to it across scans.
+		void reset();
+
+		// dy is the distance between scanlines. estimate is the size of the expected motion blur. If there are already results, this does nothing; use rescan or reset first.
 		void scan(Ptr<Image> source, const Radians<> & gravity_rotation, std::size_t dy = 15);
 
+		// Scan the image of the image update, loading it from the frame cache if needed. If there is no image, nothing is scanned. The channels are averaged, exactly as for scan(Ptr<Image>), rather than using the weighted luma of ImageUpdate::luminance().
+		void scan(const ImageUpdate & image_update, const Radians<> & gravity_rotation, std::size_t dy = 15);
+
+		// Scan pixel data directly, e.g. the luma plane of a camera frame. The plane is only used during the scan, and source() will be null.
+		void scan(const PixelPlane & plane, const Radians<> & gravity_rotation, std::size_t dy = 15);
+
+		void rescan(Ptr<Image> source, const Radians<> & gravity_rotation, std::size_t dy = 15) { reset(); scan(source, gravity_rotation, dy); }
+		void rescan(const ImageUpdate & image_update, const Radians<> & gravity_rotation, std::size_t dy = 15) { reset(); scan(image_update, gravity_rotation, dy); }
+		void rescan(const PixelPlane & plane, const Radians<> & gravity_rotation, std::size_t dy = 15) { reset(); scan(plane, gravity_rotation, dy); }
+
+		// False until an image has been scanned, e.g. if the image of an image update was missing. The table is only valid once scanned.
+		bool scanned() const { return _scanned; }
+
 		Ref<FeatureTable> table() { return _table; }
 
+		// The image that was scanned. If an image update was scanned, this is its image buffer, which is null for images loaded on demand, so that feature points don't keep frames alive.
 		Ref<Image> source() const { return _source; }
 		const std::vector<Vec2> & offsets() const { return _offsets; }
 
@@ -60,6 +138,19 @@ namespace TransformFlow {
 
 		const AlignedBox2 & bounding_box() const { return _bounding_box; }
 	};
+
+	// Keeps released feature points so that their memory can be reused, rather than allocating new feature points and tables for every frame. Only the scan itself is allocation free; e.g. VisionCorrection still allocates the notes it adds to each image update.
+	class FeaturePointsPool : public Object {
+	protected:
+		std::vector<Ref<FeaturePoints>> _available;
+
+	public:
+		// Returns a reset instance, which may have been used previously.
+		Ref<FeaturePoints> acquire();
+
+		// The caller must not use the feature points after releasing them.
+		void release(Ref<FeaturePoints> feature_points);
+	};
 }
 
 #endif
@@ -13,16 +13,31 @@
 #include <Euclid/Numerics/Average.h>
 #include <Euclid/Numerics/Interpolate.h>
 
+#include <algorithm>
+
 namespace TransformFlow {
 
 	using namespace Dream::Events::Logging;
 
-	FeatureTable::FeatureTable(RealT dy, RealT pixels_per_bin, const AlignedBox2 & bounds, const Radians<> & rotation) : _dy(dy), _bounds(ZERO), _pixels_per_bin(pixels_per_bin)
+	FeatureTable::FeatureTable(RealT dy, RealT pixels_per_bin, const AlignedBox2 & bounds, const Radians<> & rotation) : _bounds(ZERO), _pyramid_built(false)
+	{
+		reset(dy, pixels_per_bin, bounds, rotation);
+	}
+
+	FeatureTable::~FeatureTable()
+	{
+	}
+
+	void FeatureTable::reset(RealT dy, RealT pixels_per_bin, const AlignedBox2 & bounds, const Radians<> & rotation)
 	{
+		_dy = dy;
+		_pixels_per_bin = pixels_per_bin;
+
 		// The bounds provided are the bounds of the image. Points are image coordinates, but this isn't suitable for binning. We want to bin along the axis perpendicular to gravity, so we make a rotation which does this. We also want to center the table at the origin, so we apply a translation.
 		_transform = rotate<Z>(rotation) << translate(-bounds.size() / 2.0);
 
 		// Calculate a new rotated bounding box:
+		_bounds = ZERO;
 		_bounds.union_with_point(_transform * bounds.min());
 		_bounds.union_with_point(_transform * bounds.max());
 		_bounds.union_with_point(_transform * bounds.corner({false, true}));
@@ -33,56 +48,127 @@ namespace TransformFlow {
 
 		std::size_t number_of_bins = bins_per_half_width * 2;
 
-		// Allocate the bins:
-		_bins.resize(number_of_bins);
-	}
+		_added_features.clear();
+		_added_bins.clear();
 
-	FeatureTable::~FeatureTable()
-	{
+		// Allocate the (empty) bins:
+		_bin_counts.assign(number_of_bins, 0);
+		_bin_means.assign(number_of_bins, 0);
+		_bin_offsets.assign(number_of_bins + 1, 0);
+
+		_histograms.resize(HISTOGRAM_LEVELS);
+		_histograms[0].assign(number_of_bins, 0);
+		_pyramid_built = false;
+
+		_features.clear();
 	}
 
-	std::size_t FeatureTable::bin_index_for_offset(RealT x)
+	std::size_t FeatureTable::bin_index_for_offset(RealT x) const
 	{
 		// Adventure Time:
 		auto b = x / _pixels_per_bin;
-		auto m = _bins.size() / 2;
+		auto m = _bin_counts.size() / 2;
 		auto o = b + m;
 
-		if (o == _bins.size())
+		if (o == _bin_counts.size())
 			o -= 1;
 
-		assert(o >= 0 && o < _bins.size());
+		assert(o >= 0 && o < _bin_counts.size());
 
 		return o;
 	}
 
-	FeatureTable::Index FeatureTable::add_feature(const Vec2 &offset)
+	void FeatureTable::update(const std::vector<Vec2> &offsets)
 	{
-		// The aligned offset is the coordinate relative to the origin, with -Z = gravity.
-		auto aligned_offset = _transform * offset;
+		for (auto & offset : offsets) {
+			// The aligned offset is the coordinate relative to the origin, with -Z = gravity.
+			auto aligned_offset = _transform * offset;
+
+			_added_features.push_back({aligned_offset, offset});
+			_added_bins.push_back(bin_index_for_offset(aligned_offset[X]));
+		}
+
+		rebuild();
+	}
+
+	void FeatureTable::rebuild()
+	{
+		std::fill(_bin_counts.begin(), _bin_counts.end(), 0);
+
+		for (auto bin : _added_bins)
+			_bin_counts[bin] += 1;
+
+		for (std::size_t i = 0; i < _bin_counts.size(); i += 1)
+			_bin_offsets[i+1] = _bin_offsets[i] + _bin_counts[i];
 
-		auto index = bin_index_for_offset(aligned_offset[X]);
-		auto & bin = _bins.at(index);
+		// A stable counting sort, so that the features in each bin stay in the order they were added. The counts are used as the insertion point of each bin, and end up as they were:
+		_features.resize(_added_features.size());
 
-		// Add the chain link into the correct bin:
-		bin.features.push_back({aligned_offset, offset});
+		std::fill(_bin_counts.begin(), _bin_counts.end(), 0);
 
-		return {index, bin.features.size() - 1};
+		for (std::size_t i = 0; i < _added_features.size(); i += 1) {
+			auto bin = _added_bins[i];
+
+			_features[_bin_offsets[bin] + _bin_counts[bin]] = _added_features[i];
+			_bin_counts[bin] += 1;
+		}
+
+		// Now compute the mean of each bin, summing in the same order as average_feature_position:
+		for (std::size_t i = 0; i < _bin_counts.size(); i += 1) {
+			RealT sum = 0;
+
+			for (auto & feature : bin(i))
+				sum += feature.aligned_offset[X];
+
+			_bin_means[i] = _bin_counts[i] ? sum / _bin_counts[i] : 0;
+
+			_histograms[0][i] = std::min<std::size_t>(_bin_counts[i], HISTOGRAM_MAXIMUM);
+		}
+
+		_pyramid_built = false;
 	}
 
-	void FeatureTable::update(const std::vector<Vec2> &offsets)
+	const HistogramT & FeatureTable::histogram(std::size_t level) const
 	{
-		for (auto & offset : offsets)
-			add_feature(offset);
+		if (level > 0 && !_pyramid_built.load(std::memory_order_acquire))
+			build_pyramid();
+
+		return _histograms[level];
 	}
 
-	Average<RealT> FeatureTable::average_feature_position(std::size_t bin) const
+	void FeatureTable::build_pyramid() const
+	{
+		std::lock_guard<std::mutex> guard(_pyramid_lock);
+
+		// Another thread may have built it while we were waiting:
+		if (_pyramid_built.load(std::memory_order_relaxed)) return;
+
+		// Each level of the pyramid has half as many bins as the one below:
+		for (std::size_t level = 1; level < _histograms.size(); level += 1) {
+			auto & below = _histograms[level-1];
+			auto & histogram = _histograms[level];
+
+			histogram.resize((below.size() + 1) / 2);
+
+			for (std::size_t i = 0; i < histogram.size(); i += 1) {
+				std::size_t count = below[i*2];
+
+				if (i*2 + 1 < below.size())
+					count += below[i*2 + 1];
+
+				histogram[i] = std::min<std::size_t>(count, HISTOGRAM_MAXIMUM);
+			}
+		}
+
+		_pyramid_built.store(true, std::memory_order_release);
+	}
+
+	Average<RealT> FeatureTable::average_feature_position(std::size_t index) const
 	{
 		Average<RealT> distribution;
 		
-		for (auto & feature : _bins[bin].features)
+		for (auto & feature : bin(index))
 		{
-			//log_debug("Adding chain, aligned_offset =", chain.aligned_offset, "offset =", chain.offset);
 			distribution.add_sample(feature.aligned_offset[X]);
 		}
 
@@ -93,8 +179,8 @@ namespace TransformFlow {
 	{
 		std::size_t m = 0, n = 0;
 
-		auto & a = _bins[i].features;
-		auto & b = other.bins()[j].features;
+		auto a = bin(i);
+		auto b = other.bin(j);
 
 		Average<RealT> alignment;
 
@@ -126,15 +212,13 @@ namespace TransformFlow {
 
 	Average<RealT> FeatureTable::bin_alignment_average(const FeatureTable & other, std::size_t i, std::size_t j) const
 	{
-		auto pa = average_feature_position(i);
-		auto pb = other.average_feature_position(j);
-		
 		Average<RealT> average;
 		
 		auto t = _pixels_per_bin;
 		
-		if (pa.number_of_samples() > t && pb.number_of_samples() > t)
-			average.add_sample(pb.value() - pa.value());
+		// The counts and means are computed by update(), so this doesn't need to look at individual features:
+		if (_bin_counts[i] > t && other._bin_counts[j] > t)
+			average.add_sample(other._bin_means[j] - _bin_means[i]);
 		
 		return average;
 	}
@@ -142,7 +226,7 @@ namespace TransformFlow {
 	Average<RealT> FeatureTable::calculate_offset(const FeatureTable & other, int estimate) const
 	{
 		// No bins -> no data, cannot align.
-		if (_bins.size() == 0 || other.bins().size() == 0)
+		if (bin_count() == 0 || other.bin_count() == 0)
 			return {};
 
 		assert(this->_pixels_per_bin == other._pixels_per_bin);
@@ -9,11 +9,15 @@
 #ifndef __Transform_Flow__FeatureTable__
 #define __Transform_Flow__FeatureTable__
 
+#include "HistogramKernel.h"
+
 #include <Dream/Class.h>
 
 #include <Euclid/Geometry/AlignedBox.h>
 #include <Euclid/Numerics/Average.h>
 
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 namespace TransformFlow
@@ -29,28 +33,50 @@ namespace TransformFlow
 			Vec2 aligned_offset, offset;
 		};
 
+		// A view of the features in a single bin, in the order they were added.
 		struct Bin {
-			std::vector<Feature> features;
-		};
+			const Feature * first, * last;
 
-		struct Index {
-			std::size_t bin_index;
-			std::size_t feature_index;
+			const Feature * begin() const { return first; }
+			const Feature * end() const { return last; }
+
+			std::size_t size() const { return last - first; }
+			const Feature & operator[](std::size_t index) const { return first[index]; }
 		};
 
 	protected:
 		Mat33 _transform;
 		AlignedBox2 _bounds;
-		const RealT _pixels_per_bin, _dy;
+		RealT _pixels_per_bin, _dy;
+
+		// Features are stored contiguously, sorted by bin. The features of bin i are in [_bin_offsets[i], _bin_offsets[i+1]):
+		std::vector<Feature> _features;
+		std::vector<std::size_t> _bin_offsets;
+
+		// Per-bin statistics, computed by update(), so that alignment doesn't need to recompute them:
+		std::vector<std::size_t> _bin_counts;
+		std::vector<RealT> _bin_means;
+
+		// The bin counts in the narrow format used for alignment, followed by successively coarser levels of the pyramid. Only the full search is used by default, so the coarser levels are built the first time they are needed. Tables can be shared between threads, e.g. by a snapshot, so this is locked:
+		mutable std::vector<HistogramT> _histograms;
+		mutable std::atomic<bool> _pyramid_built;
+		mutable std::mutex _pyramid_lock;
+
+		void build_pyramid() const;
 
-		std::vector<Bin> _bins;
+		// Features in the order they were added, and the bin they belong to. Used to rebuild the sorted features:
+		std::vector<Feature> _added_features;
+		std::vector<std::size_t> _added_bins;
 
-		Index add_feature(const Vec2 & offset);
+		void rebuild();
 
 	public:
 		FeatureTable(RealT dy, RealT pixels_per_bin, const AlignedBox2 & bounds, const Radians<> & rotation);
 		virtual ~FeatureTable();
 
+		// Remove all features and reinitialize the table, keeping the allocated memory.
+		void reset(RealT dy, RealT pixels_per_bin, const AlignedBox2 & bounds, const Radians<> & rotation);
+
 		RealT dy() const { return _dy; };
 		RealT pixels_per_bin() const { return _pixels_per_bin; }
 
@@ -58,9 +84,25 @@ namespace TransformFlow
 
 		virtual void update(const std::vector<Vec2> & offsets);
 
-		std::size_t bin_index_for_offset(RealT x);
+		std::size_t bin_index_for_offset(RealT x) const;
+
+		std::size_t bin_count() const { return _bin_counts.size(); }
+		Bin bin(std::size_t index) const { return {_features.data() + _bin_offsets[index], _features.data() + _bin_offsets[index+1]}; }
+
+		// All features, sorted by bin.
+		const std::vector<Feature> & features() const { return _features; }
+
+		// The number of features in each bin.
+		const std::vector<std::size_t> & bin_counts() const { return _bin_counts; }
+
+		// The number of levels in the histogram pyramid. With 2 pixels per bin, the levels have 2, 4, 8 and 16 pixels per bin.
+		static const std::size_t HISTOGRAM_LEVELS = 4;
+
+		// The number of features in each bin, saturated at HISTOGRAM_MAXIMUM. Each level of the pyramid above 0 combines pairs of bins from the level below, starting from the first bin, and is built on first use.
+		const HistogramT & histogram(std::size_t level = 0) const;
 
-		const std::vector<Bin> & bins() const { return _bins; }
+		// The mean aligned x offset of the features in each bin, or zero if the bin is empty.
+		const std::vector<RealT> & bin_means() const { return _bin_means; }
 
 		Average<RealT> average_feature_position(std::size_t bin) const;
 
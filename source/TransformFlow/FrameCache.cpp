@@ -0,0 +1,116 @@
+//
+//  FrameCache.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "FrameCache.h"
+
+namespace TransformFlow
+{
+	FrameCache::FrameCache(LoadFrameT load_frame, std::size_t budget) : _load_frame(load_frame), _budget(budget), _size(0), _loads(0)
+	{
+	}
+
+	FrameCache::~FrameCache()
+	{
+	}
+
+	std::size_t FrameCache::byte_size(Ptr<Image> image)
+	{
+		auto size = image->size();
+
+		return size[WIDTH] * size[HEIGHT] * image->layout().channel_count();
+	}
+
+	Ref<Image> FrameCache::frame(std::size_t index)
+	{
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+
+			auto iterator = _index.find(index);
+
+			if (iterator != _index.end()) {
+				// Move the entry to the front, as it's now the most recently used:
+				_entries.splice(_entries.begin(), _entries, iterator->second);
+
+				return iterator->second->image;
+			}
+		}
+
+		Ref<Image> image = _load_frame(index);
+
+		std::lock_guard<std::mutex> guard(_lock);
+
+		_loads += 1;
+
+		// Another thread may have loaded the same frame in the mean time:
+		auto iterator = _index.find(index);
+
+		if (iterator != _index.end())
+			return iterator->second->image;
+
+		if (!image) return image;
+
+		std::size_t size = byte_size(image);
+
+		_entries.push_front({index, image, size});
+		_index[index] = _entries.begin();
+		_size += size;
+
+		evict();
+
+		return image;
+	}
+
+	void FrameCache::set_budget(std::size_t budget)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		_budget = budget;
+
+		evict();
+	}
+
+	std::size_t FrameCache::size() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		return _size;
+	}
+
+	std::size_t FrameCache::count() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		return _entries.size();
+	}
+
+	std::size_t FrameCache::loads() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		return _loads;
+	}
+
+	void FrameCache::clear()
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		_entries.clear();
+		_index.clear();
+		_size = 0;
+	}
+
+	void FrameCache::evict()
+	{
+		// The most recently used entry is always kept, even if it is larger than the budget:
+		while (_size > _budget && _entries.size() > 1) {
+			auto & entry = _entries.back();
+
+			_size -= entry.size;
+			_index.erase(entry.index);
+
+			_entries.pop_back();
+		}
+	}
+}
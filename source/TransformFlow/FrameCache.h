@@ -0,0 +1,69 @@
+//
+//  FrameCache.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_FRAMECACHE_H
+#define TRANSFORMFLOW_FRAMECACHE_H
+
+#include <Dream/Imaging/Image.h>
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace TransformFlow
+{
+	using namespace Dream;
+	using namespace Dream::Imaging;
+
+	// Loads frames of a data set on demand, keeping the most recently used frames in memory. The least recently used frames are released when the total size exceeds the budget, so replaying a data set of any length uses a bounded amount of memory. Frames which are still referenced elsewhere stay alive until they are released. This class is thread safe.
+	class FrameCache : public Object
+	{
+	public:
+		typedef std::function<Ref<Image>(std::size_t index)> LoadFrameT;
+
+		FrameCache(LoadFrameT load_frame, std::size_t budget = 256 * 1024 * 1024);
+		virtual ~FrameCache();
+
+		// Loads the frame if it isn't already cached. Frames are loaded without holding the lock, so several frames can be loaded at once.
+		Ref<Image> frame(std::size_t index);
+
+		std::size_t budget() const { return _budget; }
+		void set_budget(std::size_t budget);
+
+		// The number of bytes of pixel data currently cached:
+		std::size_t size() const;
+		std::size_t count() const;
+
+		// The number of times a frame has been loaded, including frames which were loaded again after being released:
+		std::size_t loads() const;
+
+		void clear();
+
+		// The size of the pixel data of an 8-bit image.
+		static std::size_t byte_size(Ptr<Image> image);
+
+	protected:
+		LoadFrameT _load_frame;
+
+		struct Entry {
+			std::size_t index;
+			Ref<Image> image;
+			std::size_t size;
+		};
+
+		mutable std::mutex _lock;
+
+		// Most recently used entries are at the front:
+		std::list<Entry> _entries;
+		std::unordered_map<std::size_t, std::list<Entry>::iterator> _index;
+
+		std::size_t _budget, _size, _loads;
+
+		void evict();
+	};
+}
+
+#endif
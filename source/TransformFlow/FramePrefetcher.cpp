@@ -0,0 +1,120 @@
+//
+//  FramePrefetcher.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "FramePrefetcher.h"
+
+namespace TransformFlow
+{
+	FramePrefetcher::FramePrefetcher(Ref<ThreadPool> thread_pool, std::size_t depth) : _thread_pool(thread_pool), _depth(depth), _first(0), _outstanding(0), _budget_checked(false)
+	{
+		if (_depth > 0 && !_thread_pool)
+			_thread_pool = new ThreadPool;
+	}
+
+	FramePrefetcher::FramePrefetcher(const std::vector<Shared<SensorUpdate>> & sensor_updates, Ref<ThreadPool> thread_pool, std::size_t depth) : FramePrefetcher(thread_pool, depth)
+	{
+		for (auto & sensor_update : sensor_updates) {
+			if (Shared<ImageUpdate> image_update = sensor_update)
+				push(image_update);
+		}
+	}
+
+	FramePrefetcher::~FramePrefetcher()
+	{
+		// The tasks refer to this object, so they must be finished before we go away:
+		std::unique_lock<std::mutex> lock(_lock);
+		_condition.wait(lock, [&]{return _outstanding == 0;});
+	}
+
+	void FramePrefetcher::push(Shared<ImageUpdate> image_update)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		_pending.push_back(image_update);
+
+		submit();
+	}
+
+	void FramePrefetcher::submit()
+	{
+		while (_slots.size() < _depth && !_pending.empty()) {
+			Shared<ImageUpdate> image_update = _pending.front();
+			_pending.pop_front();
+
+			std::size_t sequence = _first + _slots.size();
+
+			_slots.push_back({nullptr, nullptr, false});
+			_outstanding += 1;
+
+			_thread_pool->add(std::bind(&FramePrefetcher::load, this, sequence, image_update));
+		}
+	}
+
+	void FramePrefetcher::load(std::size_t sequence, Shared<ImageUpdate> image_update)
+	{
+		Slot slot = {nullptr, nullptr, true};
+
+		try {
+			slot.image = image_update->image();
+		} catch (...) {
+			slot.error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> guard(_lock);
+
+		// The prefetched images have to fit in the cache, otherwise they would be released and loaded again when they are used:
+		if (slot.image && !_budget_checked) {
+			_budget_checked = true;
+
+			Ref<FrameCache> frame_cache = image_update->frame_cache;
+
+			if (frame_cache) {
+				std::size_t required = (_depth + 1) * FrameCache::byte_size(slot.image);
+
+				if (frame_cache->budget() < required)
+					frame_cache->set_budget(required);
+			}
+		}
+
+		_slots[sequence - _first] = slot;
+		_outstanding -= 1;
+
+		_condition.notify_all();
+	}
+
+	Ref<Image> FramePrefetcher::next()
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+
+		if (_depth == 0) {
+			if (_pending.empty()) return nullptr;
+
+			Shared<ImageUpdate> image_update = _pending.front();
+			_pending.pop_front();
+
+			lock.unlock();
+
+			return image_update->image();
+		}
+
+		if (_slots.empty()) return nullptr;
+
+		_condition.wait(lock, [&]{return _slots.front().ready;});
+
+		Slot slot = _slots.front();
+		_slots.pop_front();
+		_first += 1;
+
+		// Only now that the consumer has taken an image is another one started:
+		submit();
+
+		lock.unlock();
+
+		if (slot.error)
+			std::rethrow_exception(slot.error);
+
+		return slot.image;
+	}
+}
@@ -0,0 +1,67 @@
+//
+//  FramePrefetcher.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_FRAMEPREFETCHER_H
+#define TRANSFORMFLOW_FRAMEPREFETCHER_H
+
+#include "MotionModel.h"
+#include "ThreadPool.h"
+
+#include <deque>
+#include <exception>
+
+namespace TransformFlow
+{
+	// Loads the images of upcoming image updates on a thread pool, so that they are ready when a sequential replay reaches them. Images are handed over in the order of the updates. At most depth images are loaded ahead of the consumer, which bounds memory use and stops the decoders getting too far ahead. Images are loaded using ImageUpdate::image(), so they also end up in the frame cache, whose budget is increased if it can't hold the prefetched images.
+	class FramePrefetcher
+	{
+	public:
+		// If no thread pool is given, one is created. A depth of 0 disables prefetching, so images are loaded when they are requested.
+		FramePrefetcher(Ref<ThreadPool> thread_pool = nullptr, std::size_t depth = 8);
+
+		// Prefetch the images of all the image updates.
+		FramePrefetcher(const std::vector<Shared<SensorUpdate>> & sensor_updates, Ref<ThreadPool> thread_pool = nullptr, std::size_t depth = 8);
+
+		// Waits for outstanding loads to finish.
+		~FramePrefetcher();
+
+		std::size_t depth() const { return _depth; }
+
+		// Add an image update to the end of the sequence. Its image is loaded once fewer than depth images are ahead of the consumer.
+		void push(Shared<ImageUpdate> image_update);
+
+		// The image of the next image update in the sequence, waiting for it to be loaded if needed. Returns null once all images which have been pushed have been handed over. If loading the image failed, the exception is rethrown here.
+		Ref<Image> next();
+
+	protected:
+		// Image updates whose images haven't started loading yet:
+		std::deque<Shared<ImageUpdate>> _pending;
+
+		Ref<ThreadPool> _thread_pool;
+		std::size_t _depth;
+
+		struct Slot
+		{
+			Ref<Image> image;
+			std::exception_ptr error;
+			bool ready;
+		};
+
+		std::mutex _lock;
+		std::condition_variable _condition;
+
+		// The slot for the next image to be handed over is at the front, followed by the images being loaded ahead of it. _first is the sequence number of the front slot:
+		std::deque<Slot> _slots;
+		std::size_t _first, _outstanding;
+
+		bool _budget_checked;
+
+		// Start loading pending images, while there are fewer than depth slots.
+		void submit();
+		void load(std::size_t sequence, Shared<ImageUpdate> image_update);
+	};
+}
+
+#endif
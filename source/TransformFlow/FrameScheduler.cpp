@@ -0,0 +1,80 @@
+//
+//  FrameScheduler.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "FrameScheduler.h"
+
+namespace TransformFlow
+{
+	const RealT FrameScheduler::RECOVERY_THRESHOLD = 0.5;
+	const std::size_t FrameScheduler::ADAPTATION_SCANS = 10;
+
+	// The weight of the most recent scan in the average:
+	static const TimeT SCAN_TIME_SMOOTHING = 0.2;
+
+	FrameScheduler::FrameScheduler(std::size_t dy) : _level(0), _budget(0), _average_scan_time(0), _level_scans(0), _primed(false), _last_frame_time(0), _scanned_frames(0), _dropped_frames(0), _quality_changes(0)
+	{
+		// Scan time is roughly proportional to the number of scanlines. Wider bins keep the histogram counts similar as the scanlines get sparser:
+		_levels = {
+			{dy, 2},
+			{dy * 3 / 2, 2},
+			{dy * 2, 4},
+			{dy * 3, 4},
+			{dy * 4, 8},
+		};
+	}
+
+	void FrameScheduler::set_budget(TimeT budget)
+	{
+		_budget = budget;
+
+		if (_budget <= 0)
+			change_level(0);
+	}
+
+	bool FrameScheduler::should_scan(TimeT frame_time)
+	{
+		// If the previous frame was scanned, and this frame arrived sooner than it would take to scan it, we are behind:
+		if (_budget > 0 && _primed && (frame_time - _last_frame_time) < _average_scan_time) {
+			_dropped_frames += 1;
+
+			return false;
+		}
+
+		_primed = true;
+		_last_frame_time = frame_time;
+		_scanned_frames += 1;
+
+		return true;
+	}
+
+	void FrameScheduler::record_scan(TimeT duration)
+	{
+		if (_level_scans == 0)
+			_average_scan_time = duration;
+		else
+			_average_scan_time += (duration - _average_scan_time) * SCAN_TIME_SMOOTHING;
+
+		_level_scans += 1;
+
+		if (_budget <= 0 || _level_scans < ADAPTATION_SCANS) return;
+
+		if (_average_scan_time > _budget) {
+			if (_level + 1 < _levels.size())
+				change_level(_level + 1);
+		} else if (_average_scan_time < _budget * RECOVERY_THRESHOLD) {
+			if (_level > 0)
+				change_level(_level - 1);
+		}
+	}
+
+	void FrameScheduler::change_level(std::size_t level)
+	{
+		if (level == _level) return;
+
+		_level = level;
+		_level_scans = 0;
+		_quality_changes += 1;
+	}
+}
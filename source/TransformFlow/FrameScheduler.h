@@ -0,0 +1,87 @@
+//
+//  FrameScheduler.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_FRAMESCHEDULER_H
+#define TRANSFORMFLOW_FRAMESCHEDULER_H
+
+#include <Dream/Class.h>
+#include <Dream/Core/Timer.h>
+#include <Euclid/Numerics/Numerics.h>
+
+#include <vector>
+
+namespace TransformFlow
+{
+	using namespace Dream;
+	using namespace Dream::Core;
+	using namespace Euclid::Numerics;
+
+	// Decides which camera frames are scanned, and how densely, so that the time spent scanning each frame stays within a budget. Scan times are measured by the caller and reported using record_scan. Not thread safe.
+	class FrameScheduler
+	{
+	public:
+		// The parameters used to scan a frame. Fewer scanlines and wider bins are faster to scan and align, but less precise.
+		struct Quality
+		{
+			std::size_t dy;
+			RealT pixels_per_bin;
+
+			bool operator==(const Quality & other) const { return dy == other.dy && pixels_per_bin == other.pixels_per_bin; }
+			bool operator!=(const Quality & other) const { return !(*this == other); }
+		};
+
+		// The quality is reduced if the average scan time exceeds the budget, and increased again if it falls below this fraction of the budget:
+		static const RealT RECOVERY_THRESHOLD;
+
+		// The minimum number of scans at one quality before it can change again, so that the average reflects the new quality:
+		static const std::size_t ADAPTATION_SCANS;
+
+		// dy is the scanline spacing at the highest quality.
+		FrameScheduler(std::size_t dy = 15);
+
+		// The target time to scan one frame, in seconds. A budget of zero disables scheduling, so every frame is scanned at the highest quality.
+		TimeT budget() const { return _budget; }
+		void set_budget(TimeT budget);
+
+		// Returns false if the frame should be dropped, because frames are arriving faster than they can be scanned.
+		bool should_scan(TimeT frame_time);
+
+		// Record how long it took to scan a frame, in seconds, which may change the quality.
+		void record_scan(TimeT duration);
+
+		// The quality to use when scanning the next frame.
+		const Quality & quality() const { return _levels.at(_level); }
+
+		// 0 is the highest quality.
+		std::size_t level() const { return _level; }
+		std::size_t levels() const { return _levels.size(); }
+
+		// An exponential moving average of recent scan times.
+		TimeT average_scan_time() const { return _average_scan_time; }
+
+		std::size_t scanned_frames() const { return _scanned_frames; }
+		std::size_t dropped_frames() const { return _dropped_frames; }
+		std::size_t quality_changes() const { return _quality_changes; }
+
+	protected:
+		std::vector<Quality> _levels;
+		std::size_t _level;
+
+		TimeT _budget;
+
+		// Scan times at the current level:
+		TimeT _average_scan_time;
+		std::size_t _level_scans;
+
+		bool _primed;
+		TimeT _last_frame_time;
+
+		std::size_t _scanned_frames, _dropped_frames, _quality_changes;
+
+		void change_level(std::size_t level);
+	};
+}
+
+#endif
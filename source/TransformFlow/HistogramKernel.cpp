@@ -0,0 +1,125 @@
+//
+//  HistogramKernel.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "HistogramKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define TRANSFORM_FLOW_X86_KERNELS
+	#include <immintrin.h>
+#endif
+
+namespace TransformFlow
+{
+	static std::uint64_t sum_squared_differences_scalar(const std::uint16_t * u, const std::uint16_t * v, std::size_t first, std::size_t last)
+	{
+		std::uint64_t sum = 0;
+
+		for (std::size_t i = first; i < last; i += 1) {
+			std::int64_t d = std::int64_t(u[i]) - std::int64_t(v[i]);
+
+			sum += d * d;
+		}
+
+		return sum;
+	}
+
+#ifdef TRANSFORM_FLOW_X86_KERNELS
+	__attribute__((target("sse4.1")))
+	static std::size_t sum_squared_differences_sse4(const std::uint16_t * u, const std::uint16_t * v, std::size_t count, std::uint64_t & sum)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i total = zero;
+
+		std::size_t i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			__m128i d = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(u + i)), _mm_loadu_si128((const __m128i *)(v + i)));
+
+			// Pairs of squares, which can't overflow because the counts are saturated:
+			__m128i squares = _mm_madd_epi16(d, d);
+
+			total = _mm_add_epi64(total, _mm_unpacklo_epi32(squares, zero));
+			total = _mm_add_epi64(total, _mm_unpackhi_epi32(squares, zero));
+		}
+
+		alignas(16) std::uint64_t lanes[2];
+		_mm_store_si128((__m128i *)lanes, total);
+
+		sum += lanes[0] + lanes[1];
+
+		return i;
+	}
+
+	__attribute__((target("avx2")))
+	static std::size_t sum_squared_differences_avx2(const std::uint16_t * u, const std::uint16_t * v, std::size_t count, std::uint64_t & sum)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i total = zero;
+
+		std::size_t i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			__m256i d = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *)(u + i)), _mm256_loadu_si256((const __m256i *)(v + i)));
+
+			__m256i squares = _mm256_madd_epi16(d, d);
+
+			total = _mm256_add_epi64(total, _mm256_unpacklo_epi32(squares, zero));
+			total = _mm256_add_epi64(total, _mm256_unpackhi_epi32(squares, zero));
+		}
+
+		alignas(32) std::uint64_t lanes[4];
+		_mm256_store_si256((__m256i *)lanes, total);
+
+		sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+		return i;
+	}
+#endif
+
+	bool histogram_kernel_supported(ScanlineKernel kernel)
+	{
+		switch (kernel) {
+			case ScanlineKernel::AUTOMATIC:
+			case ScanlineKernel::SCALAR:
+				return true;
+
+#ifdef TRANSFORM_FLOW_X86_KERNELS
+			case ScanlineKernel::SSE4:
+				return __builtin_cpu_supports("sse4.1");
+			case ScanlineKernel::AVX2:
+				return __builtin_cpu_supports("avx2");
+#endif
+
+			default:
+				return false;
+		}
+	}
+
+	ScanlineKernel best_histogram_kernel()
+	{
+		static const ScanlineKernel kernel = histogram_kernel_supported(ScanlineKernel::AVX2) ? ScanlineKernel::AVX2 : histogram_kernel_supported(ScanlineKernel::SSE4) ? ScanlineKernel::SSE4 : ScanlineKernel::SCALAR;
+
+		return kernel;
+	}
+
+	std::uint64_t sum_squared_differences(const std::uint16_t * u, const std::uint16_t * v, std::size_t count, ScanlineKernel kernel)
+	{
+		std::uint64_t sum = 0;
+		std::size_t first = 0;
+
+		if (kernel == ScanlineKernel::AUTOMATIC || !histogram_kernel_supported(kernel))
+			kernel = best_histogram_kernel();
+
+#ifdef TRANSFORM_FLOW_X86_KERNELS
+		// The vectorised kernels process as many full blocks as possible, and the remainder is handled by the scalar kernel:
+		if (kernel == ScanlineKernel::AVX2)
+			first = sum_squared_differences_avx2(u, v, count, sum);
+		else if (kernel == ScanlineKernel::SSE4)
+			first = sum_squared_differences_sse4(u, v, count, sum);
+#endif
+
+		return sum + sum_squared_differences_scalar(u, v, first, count);
+	}
+}
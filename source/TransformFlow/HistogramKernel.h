@@ -0,0 +1,31 @@
+//
+//  HistogramKernel.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_HISTOGRAMKERNEL_H
+#define TRANSFORMFLOW_HISTOGRAMKERNEL_H
+
+#include "ScanlineKernel.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace TransformFlow
+{
+	// Feature counts per bin. Counts are saturated at HISTOGRAM_MAXIMUM, so that the difference between two bins fits in a signed 16-bit integer and histograms can be compared eight or sixteen bins at a time.
+	typedef std::vector<std::uint16_t> HistogramT;
+
+	const std::uint16_t HISTOGRAM_MAXIMUM = 0x7FFF;
+
+	// The histogram kernels work on integers, so unlike the scanline kernels, they don't depend on RealT, only on the CPU.
+	bool histogram_kernel_supported(ScanlineKernel kernel);
+
+	// Returns the fastest supported histogram kernel, never AUTOMATIC.
+	ScanlineKernel best_histogram_kernel();
+
+	// The exact sum of (u[i] - v[i])^2 for i < count. The kernels are selected in the same way as the scanline edge detector, and all produce identical results.
+	std::uint64_t sum_squared_differences(const std::uint16_t * u, const std::uint16_t * v, std::size_t count, ScanlineKernel kernel = ScanlineKernel::AUTOMATIC);
+}
+
+#endif
@@ -10,96 +10,256 @@
 
 #include <Dream/Events/Logger.h>
 #include <cmath>
+#include <functional>
 
 namespace TransformFlow
 {
 	using namespace Dream::Events::Logging;
 
-	HybridMotionModel::HybridMotionModel(std::size_t dy) : _dy(dy)
+	HybridMotionModel::HybridMotionModel(std::size_t dy, Ref<ThreadPool> thread_pool) : _scheduler(dy), _vision(dy, thread_pool), _asynchronous(false), _scanning(false), _latest_frame_time(0), _applied_frame_time(0), _submitted_frames(0), _pending_frames(0), _dropped_frames(0)
 	{
 	}
 	
 	HybridMotionModel::~HybridMotionModel()
 	{
+		// The worker refers to this model, so it must be finished before we go away:
+		std::unique_lock<std::mutex> lock(_vision_lock);
+		_vision_condition.wait(lock, [&]{return !_scanning;});
 	}
 
-	RealT HybridMotionModel::History::calculate_estimate(const ImageUpdate & image_update, Radians<> current_relative_rotation) const
+	void HybridMotionModel::update(const HeadingUpdate & heading_update)
 	{
-		auto dr = current_relative_rotation - relative_rotation;
-		return image_update.pixels_of(dr);
+		apply_scanned_frames();
+
+		BasicSensorMotionModel::update(heading_update);
 	}
-	
-	Average<RealT> HybridMotionModel::History::calculate_offset(Ptr<FeaturePoints> current_feature_points, const RealT & estimate) const
+
+	void HybridMotionModel::update(const MotionUpdate & motion_update)
 	{
-		auto current_table = current_feature_points->table();
-		auto previous_table = feature_points->table();
+		apply_scanned_frames();
 
-		return previous_table->calculate_offset(*current_table, -estimate);
+		BasicSensorMotionModel::update(motion_update);
 	}
 
-	RealT HybridMotionModel::History::calculate_bearing(const ImageUpdate & image_update, const Average<RealT> & offset) const
+	void HybridMotionModel::update(const MotionUpdate * motion_updates, std::size_t count)
 	{
-		// The offset is measured in pixels, so we convert it to degrees and use it to rectify errors in the gyro/compass:
-		RealT image_bearing_offset = R2D * image_update.angle_of(offset.value());
+		apply_scanned_frames();
 
-		return corrected_bearing + image_bearing_offset;
+		BasicSensorMotionModel::update(motion_updates, count);
 	}
 
 	void HybridMotionModel::update(const ImageUpdate & image_update)
 	{
+		apply_scanned_frames();
+
 		if (!BasicSensorMotionModel::localization_valid()) return;
 
-		Ref<FeaturePoints> current_feature_points = new FeaturePoints;
-		current_feature_points->scan(image_update.image_buffer, tilt(), _dy);
+		if (!_scheduler.should_scan(image_update.time_offset)) {
+			if (!_asynchronous)
+				image_update.add_note("Frame dropped, scanning is behind.");
 
-		StringStreamT note;
+			return;
+		}
 
-		if (_history.feature_points)
-		{
-			auto estimate = _history.calculate_estimate(image_update, _relative_rotation);
-			auto offset = _history.calculate_offset(current_feature_points, estimate);
+		Frame frame = {image_update, tilt(), _fusion.relative_rotation(), _fusion.bearing(), _vision.acquire(), _scheduler.quality(), 0};
+
+		if (_asynchronous) {
+			submit(frame);
+		} else {
+			scan_frame(frame, image_update);
+
+			apply(frame, image_update);
+		}
+	}
 
-			// At least 3 vertical edges contributed to this sample:
+	void HybridMotionModel::scan_frame(Frame & frame, const ImageUpdate & image_update)
+	{
+		Stopwatch watch;
+		watch.start();
 
-			if (offset.number_of_samples() >= 3) {
-				RealT image_bearing = _history.calculate_bearing(image_update, offset);
+		frame.feature_points->set_pixels_per_bin(frame.quality.pixels_per_bin);
+		frame.feature_points->scan(image_update, frame.tilt, frame.quality.dy);
 
-				note << "Hybrid update (confidence = " << offset.number_of_samples() << "). Hybrid: " << (image_bearing - _history.corrected_bearing) << " Sensors: " << (_bearing - _previous_bearing) << std::endl;
+		watch.pause();
 
-				auto updated_bearing = interpolateAnglesDegrees(_bearing, image_bearing, 0.995);
+		frame.scan_time = watch.time();
+	}
 
-				//log_debug("Bearing update", _bearing, "previous bearing", _previous_bearing, "updated bearing", updated_bearing, "bearing offset", bearing_offset, "pixel offset", offset.value());
-				_corrected_bearing = updated_bearing;
-			} else {
-				_corrected_bearing = _bearing;
+	void HybridMotionModel::apply(const Frame & frame, const ImageUpdate & image_update)
+	{
+		// A frame without an image wasn't scanned, so it says nothing about how long scanning takes:
+		if (frame.feature_points->scanned())
+			_scheduler.record_scan(frame.scan_time);
 
-				note << "Sensor update (confidence = " << offset.number_of_samples() << "). Gyroscope: " << (_bearing - _previous_bearing) << std::endl;
-			}
+		_vision.apply(frame.feature_points, frame.relative_rotation, frame.bearing, image_update, _fusion.relative_rotation());
+	}
 
-			note << "Pixel estimate " << estimate << std::endl;
+	void HybridMotionModel::save(Snapshot & snapshot)
+	{
+		BasicSensorMotionModel::save(snapshot);
 
-			// Only update history if there is a signifcant change, otherwise keep tracking local frame of reference.
-			if (estimate < -1.0 || estimate > 1.0) {
-				note << "Updating tracking reference..." << std::endl;
-				_history = History{current_feature_points, _relative_rotation, _corrected_bearing};
-			}
+		snapshot.scheduler = _scheduler;
+		snapshot.vision = _vision.state();
 
-			image_update.add_note(note.str());
+		snapshot.latest_frame_time = _latest_frame_time;
+		snapshot.applied_frame_time = _applied_frame_time;
+		snapshot.submitted_frames = _submitted_frames;
+		snapshot.dropped_frames = _dropped_frames;
+	}
+
+	void HybridMotionModel::load(const Snapshot & snapshot)
+	{
+		BasicSensorMotionModel::load(snapshot);
+
+		_scheduler = snapshot.scheduler;
+		_vision.restore(snapshot.vision);
+
+		_latest_frame_time = snapshot.latest_frame_time;
+		_applied_frame_time = snapshot.applied_frame_time;
+		_submitted_frames = snapshot.submitted_frames;
+		_dropped_frames = snapshot.dropped_frames;
+	}
+
+	Ref<MotionModel::Snapshot> HybridMotionModel::snapshot()
+	{
+		flush();
+
+		Ref<Snapshot> snapshot = new Snapshot;
+		save(*snapshot);
+
+		return snapshot;
+	}
+
+	void HybridMotionModel::restore(const MotionModel::Snapshot & snapshot)
+	{
+		const Snapshot & hybrid_snapshot = snapshot_cast<Snapshot>(snapshot);
+
+		// Images received before the snapshot is restored don't apply to it:
+		flush();
+
+		load(hybrid_snapshot);
+	}
+
+	void HybridMotionModel::set_asynchronous(bool asynchronous)
+	{
+		if (asynchronous == _asynchronous) return;
+
+		if (asynchronous) {
+			if (!_vision_worker)
+				_vision_worker = new ThreadPool(1);
 		} else {
-			_corrected_bearing = _bearing;
-			
-			_history = History{current_feature_points, _relative_rotation, _corrected_bearing};
+			flush();
 		}
 
-		// Used to compute a hybrid update between purely sensor based update, or sensor+image based update:
-		_previous_bearing = _bearing;
+		_asynchronous = asynchronous;
 	}
-	
+
+	void HybridMotionModel::submit(const Frame & frame)
+	{
+		std::lock_guard<std::mutex> guard(_vision_lock);
+
+		if (_submitted_frames == 0)
+			_applied_frame_time = frame.image_update.time_offset;
+
+		_submitted_frames += 1;
+		_latest_frame_time = frame.image_update.time_offset;
+
+		// If the worker hasn't started on the previous image yet, it's replaced, so that the worker is always scanning the most recent image:
+		if (_next_frame.feature_points) {
+			_vision.release(_next_frame.feature_points);
+			_dropped_frames += 1;
+		} else {
+			_pending_frames += 1;
+		}
+
+		_next_frame = frame;
+
+		if (!_scanning) {
+			_scanning = true;
+			_vision_worker->add(std::bind(&HybridMotionModel::scan_frames, this));
+		}
+	}
+
+	void HybridMotionModel::scan_frames()
+	{
+		std::unique_lock<std::mutex> lock(_vision_lock);
+
+		while (_next_frame.feature_points) {
+			Frame frame = _next_frame;
+			_next_frame.feature_points = nullptr;
+
+			lock.unlock();
+			scan_frame(frame, frame.image_update);
+			lock.lock();
+
+			_scanned_frames.push_back(frame);
+		}
+
+		_scanning = false;
+		_vision_condition.notify_all();
+	}
+
+	void HybridMotionModel::apply_scanned_frames()
+	{
+		if (!_vision_worker) return;
+
+		// Applying a frame doesn't scan anything, so it's fast enough to do while holding the lock:
+		std::lock_guard<std::mutex> guard(_vision_lock);
+
+		for (auto & frame : _scanned_frames) {
+			apply(frame, frame.image_update);
+
+			_applied_frame_time = frame.image_update.time_offset;
+			_pending_frames -= 1;
+		}
+
+		_scanned_frames.clear();
+	}
+
+	void HybridMotionModel::flush()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_vision_lock);
+			_vision_condition.wait(lock, [&]{return !_scanning;});
+		}
+
+		apply_scanned_frames();
+	}
+
+	TimeT HybridMotionModel::vision_lag() const
+	{
+		std::lock_guard<std::mutex> guard(_vision_lock);
+
+		if (_pending_frames == 0)
+			return 0;
+
+		return _latest_frame_time - _applied_frame_time;
+	}
+
+	std::size_t HybridMotionModel::pending_frames() const
+	{
+		std::lock_guard<std::mutex> guard(_vision_lock);
+
+		return _pending_frames;
+	}
+
+	std::size_t HybridMotionModel::dropped_frames() const
+	{
+		std::lock_guard<std::mutex> guard(_vision_lock);
+
+		return _dropped_frames + _scheduler.dropped_frames();
+	}
+
 	Radians<> HybridMotionModel::bearing() const
 	{
-		if (_history.feature_points)
-			return degrees(_corrected_bearing);
+		if (_vision.primed())
+			return degrees(_vision.corrected_bearing());
 		else
 			return BasicSensorMotionModel::bearing();
 	}
+
+	bool HybridMotionModel::uses_images() const
+	{
+		return true;
+	}
 }
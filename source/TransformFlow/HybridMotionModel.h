@@ -10,44 +10,118 @@
 #define TRANSFORMFLOW_HYBRIDMOTIONMODEL_H
 
 #include "BasicSensorMotionModel.h"
-#include "FeaturePoints.h"
+#include "VisionCorrection.h"
+#include "FrameScheduler.h"
 
+#include <condition_variable>
 #include <list>
+#include <mutex>
 
 namespace TransformFlow
 {
 	class HybridMotionModel : public BasicSensorMotionModel
 	{
 	public:
-		HybridMotionModel(std::size_t dy = 15);
+		HybridMotionModel(std::size_t dy = 15, Ref<ThreadPool> thread_pool = nullptr);
 		virtual ~HybridMotionModel();
 
+		virtual void update(const HeadingUpdate & heading_update);
+		virtual void update(const MotionUpdate & motion_update);
 		virtual void update(const ImageUpdate & image_update);
+		virtual void update(const MotionUpdate * motion_updates, std::size_t count);
 
 		virtual Radians<> bearing() const;
+		virtual bool uses_images() const;
+
+		struct Snapshot;
+
+		// In asynchronous mode, images which have been received are scanned and applied first, see flush().
+		virtual Ref<MotionModel::Snapshot> snapshot();
+		virtual void restore(const MotionModel::Snapshot & snapshot);
+
+		// In asynchronous mode, images are scanned on a worker thread so that sensor updates aren't held up by image processing. Each result is applied by the next update, relative to the rotation and bearing recorded when the image arrived. If images arrive faster than they can be scanned, only the most recent waiting image is kept. Notes are not added to image updates in this mode, as they may no longer exist.
+		bool asynchronous() const { return _asynchronous; }
+		void set_asynchronous(bool asynchronous);
+
+		// Wait for all images to be scanned, and apply the results.
+		void flush();
+
+		// The time between the most recent image update, and the most recent image update whose result has been applied. Always zero in synchronous mode.
+		TimeT vision_lag() const;
+
+		// The number of images which have been received but not yet applied.
+		std::size_t pending_frames() const;
+
+		// The number of images which were not scanned, either because the scheduler dropped them, or because they were replaced by a more recent image before they could be scanned.
+		std::size_t dropped_frames() const;
+
+		// Set a budget on the scheduler to limit the time spent scanning each image. Images are dropped if they arrive faster than they can be scanned, and the scanline spacing and bin width are adjusted to keep scan times within the budget. Scanning at a different quality resets the tracking reference, since feature tables with different spacing can't be aligned.
+		FrameScheduler & scheduler() { return _scheduler; }
+		const FrameScheduler & scheduler() const { return _scheduler; }
 
 	protected:
-		const std::size_t _dy;
-		
-		struct History
+		FrameScheduler _scheduler;
+
+		// Corrects the bearing using the scanned images, see VisionCorrection:
+		VisionCorrection _vision;
+
+		// The state of the model when an image arrived, which is needed to apply the result of scanning it:
+		struct Frame
 		{
-			Ref<FeaturePoints> feature_points;
+			ImageUpdate image_update;
+			Radians<> tilt;
+
 			Radians<> relative_rotation;
-			RealT corrected_bearing;
-			
-			RealT calculate_estimate(const ImageUpdate & image_update, Radians<> current_relative_bearing) const;
-			Average<RealT> calculate_offset(Ptr<FeaturePoints> current_feature_points, const RealT & estimate) const;
-			RealT calculate_bearing(const ImageUpdate & image_update, const Average<RealT> & offset) const;
+			RealT bearing;
+
+			Ref<FeaturePoints> feature_points;
+
+			// The quality chosen by the scheduler, and how long the scan took:
+			FrameScheduler::Quality quality;
+			TimeT scan_time;
+		};
+
+		static void scan_frame(Frame & frame, const ImageUpdate & image_update);
+
+		// Update the bearing using a scanned frame. Notes are added to the given image update.
+		void apply(const Frame & frame, const ImageUpdate & image_update);
+
+		bool _asynchronous;
+
+		// Scans images in order, one at a time:
+		Ref<ThreadPool> _vision_worker;
+
+		mutable std::mutex _vision_lock;
+		std::condition_variable _vision_condition;
+
+		// The image waiting to be scanned, if any, and whether the worker is currently scanning images:
+		Frame _next_frame;
+		bool _scanning;
+
+		std::vector<Frame> _scanned_frames;
+
+		TimeT _latest_frame_time, _applied_frame_time;
+		std::size_t _submitted_frames, _pending_frames, _dropped_frames;
+
+		void submit(const Frame & frame);
+		void scan_frames();
+		void apply_scanned_frames();
+
+	public:
+		struct Snapshot : public BasicSensorMotionModel::Snapshot
+		{
+			FrameScheduler scheduler;
+
+			VisionCorrection::State vision;
+
+			TimeT latest_frame_time, applied_frame_time;
+			std::size_t submitted_frames, dropped_frames;
 		};
-		
-		History _history;
-		
-		bool _corrected_bearing_primed;
-		
-		RealT _corrected_bearing;
-		
-		// Measured in degrees from north:
-		RealT _previous_bearing;
+
+	protected:
+		// The feature points in the snapshot are shared with the model, see VisionCorrection::state().
+		void save(Snapshot & snapshot);
+		void load(const Snapshot & snapshot);
 	};
 }
 
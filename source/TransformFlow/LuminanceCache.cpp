@@ -0,0 +1,132 @@
+//
+//  LuminanceCache.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "LuminanceCache.h"
+#include "FeatureAlgorithm.h"
+#include "FrameCache.h"
+
+namespace TransformFlow
+{
+	Luminance::Luminance(Ptr<Image> image) : _image(image)
+	{
+		// Greyscale images are wrapped without copying, which is safe because we keep a reference to the image:
+		convert_to_greyscale(image, _pixels);
+	}
+
+	Luminance::~Luminance()
+	{
+	}
+
+	PixelPlane Luminance::plane() const
+	{
+		return {_pixels.data, (std::size_t)_pixels.cols, (std::size_t)_pixels.rows, _pixels.step[0], 1};
+	}
+
+	std::size_t Luminance::byte_size() const
+	{
+		// The image is kept alive too, so it's counted, otherwise the cache could pin far more decoded frames than FrameCache allows. A greyscale image is the plane itself, so it's only counted once:
+		std::size_t size = FrameCache::byte_size(_image);
+
+		if (_pixels.data != _image->data())
+			size += _pixels.step[0] * _pixels.rows;
+
+		return size;
+	}
+
+	LuminanceCache::LuminanceCache(std::size_t budget) : _budget(budget), _size(0)
+	{
+	}
+
+	LuminanceCache::~LuminanceCache()
+	{
+	}
+
+	Ref<Luminance> LuminanceCache::luminance_for(Ptr<Image> image)
+	{
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+
+			auto iterator = _index.find(image.get());
+
+			if (iterator != _index.end()) {
+				// Move the entry to the front, as it's now the most recently used:
+				_entries.splice(_entries.begin(), _entries, iterator->second);
+
+				return iterator->second->luminance;
+			}
+		}
+
+		// The conversion is done without holding the lock, so that other images can be processed at the same time:
+		Ref<Luminance> luminance = new Luminance(image);
+
+		std::lock_guard<std::mutex> guard(_lock);
+
+		// Another thread may have computed the same luminance in the mean time:
+		auto iterator = _index.find(image.get());
+
+		if (iterator != _index.end())
+			return iterator->second->luminance;
+
+		_entries.push_front({image.get(), luminance});
+		_index[image.get()] = _entries.begin();
+		_size += luminance->byte_size();
+
+		evict();
+
+		return luminance;
+	}
+
+	void LuminanceCache::set_budget(std::size_t budget)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		_budget = budget;
+
+		evict();
+	}
+
+	std::size_t LuminanceCache::size() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		return _size;
+	}
+
+	std::size_t LuminanceCache::count() const
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		return _entries.size();
+	}
+
+	void LuminanceCache::clear()
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+
+		_entries.clear();
+		_index.clear();
+		_size = 0;
+	}
+
+	void LuminanceCache::evict()
+	{
+		// The most recently used entry is always kept, even if it is larger than the budget:
+		while (_size > _budget && _entries.size() > 1) {
+			auto & entry = _entries.back();
+
+			_size -= entry.luminance->byte_size();
+			_index.erase(entry.image);
+
+			_entries.pop_back();
+		}
+	}
+
+	Ref<LuminanceCache> LuminanceCache::shared_cache()
+	{
+		static Ref<LuminanceCache> cache = new LuminanceCache;
+
+		return cache;
+	}
+}
@@ -0,0 +1,79 @@
+//
+//  LuminanceCache.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_LUMINANCECACHE_H
+#define TRANSFORMFLOW_LUMINANCECACHE_H
+
+#include "PixelPlane.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace TransformFlow
+{
+	// The 8-bit greyscale version of an image. Greyscale images are used directly, otherwise the luminance is computed once when this is constructed.
+	class Luminance : public Object
+	{
+	public:
+		Luminance(Ptr<Image> image);
+		virtual ~Luminance();
+
+		Ref<Image> image() const { return _image; }
+
+		const cv::Mat & pixels() const { return _pixels; }
+		PixelPlane plane() const;
+
+		// The memory kept alive by this object: the image, and the greyscale copy unless the image was already greyscale.
+		std::size_t byte_size() const;
+
+	protected:
+		Ref<Image> _image;
+		cv::Mat _pixels;
+	};
+
+	// Shares the luminance of recently used images between all consumers, so that it is computed at most once per image. Each entry keeps its image alive, so the budget includes the images as well as the planes. The least recently used entries are evicted when the total size exceeds the budget. This class is thread safe.
+	class LuminanceCache : public Object
+	{
+	public:
+		LuminanceCache(std::size_t budget = 64 * 1024 * 1024);
+		virtual ~LuminanceCache();
+
+		// Computes the luminance if it isn't already cached.
+		Ref<Luminance> luminance_for(Ptr<Image> image);
+
+		std::size_t budget() const { return _budget; }
+		void set_budget(std::size_t budget);
+
+		// The number of bytes currently kept alive by cached entries:
+		std::size_t size() const;
+		std::size_t count() const;
+
+		void clear();
+
+		// The cache used by ImageUpdate::luminance().
+		static Ref<LuminanceCache> shared_cache();
+
+	protected:
+		struct Entry {
+			const Image * image;
+			Ref<Luminance> luminance;
+		};
+
+		mutable std::mutex _lock;
+
+		// Most recently used entries are at the front:
+		std::list<Entry> _entries;
+		std::unordered_map<const Image *, std::list<Entry>::iterator> _index;
+
+		std::size_t _budget, _size;
+
+		void evict();
+	};
+}
+
+#endif
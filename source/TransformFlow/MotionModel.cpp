@@ -7,6 +7,7 @@
 //
 
 #include "MotionModel.h"
+#include "LuminanceCache.h"
 
 #include <Euclid/Geometry/Plane.h>
 
@@ -52,6 +53,10 @@ namespace TransformFlow
 		model->update(*this);
 	}
 
+	ImageUpdate::ImageUpdate() : frame_index(0)
+	{
+	}
+
 	ImageUpdate::~ImageUpdate()
 	{
 	}
@@ -61,6 +66,19 @@ namespace TransformFlow
 		model->update(*this);
 	}
 
+	Ref<Luminance> ImageUpdate::luminance() const
+	{
+		return LuminanceCache::shared_cache()->luminance_for(image());
+	}
+
+	Ref<Image> ImageUpdate::image() const
+	{
+		if (image_buffer || !frame_cache)
+			return image_buffer;
+
+		return frame_cache->frame(frame_index);
+	}
+
 	RealT ImageUpdate::distance_from_origin(RealT width) const
 	{
 		// opposite = width, adjacent = distance_from_origin
@@ -70,17 +88,17 @@ namespace TransformFlow
 
 	RealT ImageUpdate::distance_from_origin()
 	{
-		return distance_from_origin(image_buffer->size()[WIDTH]);
+		return distance_from_origin(image()->size()[WIDTH]);
 	}
 
 	Radians<> ImageUpdate::angle_of(RealT pixels) const
 	{
-		return (field_of_view / image_buffer->size()[WIDTH]) * pixels;
+		return (field_of_view / image()->size()[WIDTH]) * pixels;
 	}
 	
 	RealT ImageUpdate::pixels_of(Radians<> angle) const
 	{
-		return angle / (field_of_view / image_buffer->size()[WIDTH]);
+		return angle / (field_of_view / image()->size()[WIDTH]);
 	}
 
 	MotionModel::MotionModel() : _camera_axis(0, 0, -1)
@@ -92,21 +110,51 @@ namespace TransformFlow
 	{
 	}
 
+	MotionModel::Snapshot::~Snapshot()
+	{
+	}
+
+	void MotionModel::save(Snapshot & snapshot) const
+	{
+		snapshot.camera_axis = _camera_axis;
+	}
+
+	void MotionModel::load(const Snapshot & snapshot)
+	{
+		_camera_axis = snapshot.camera_axis;
+	}
+
 	void MotionModel::update(SensorUpdate * sensor_update)
 	{
 		sensor_update->apply(this);
 	}
 
+	void MotionModel::update(const MotionUpdate * motion_updates, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; i += 1)
+			update(motion_updates[i]);
+	}
+
 	bool MotionModel::localization_valid() const
 	{
 		return !gravity().equivalent({0, 0, 0});
 	}
 
+	bool MotionModel::uses_images() const
+	{
+		return true;
+	}
+
 	Radians<> MotionModel::tilt() const
+	{
+		return device_tilt(gravity());
+	}
+
+	Radians<> device_tilt(const Vec3 & gravity)
 	{
 		// This code calculates the right vector in device centric coordinates.
 		// If gravity is naturally -Y, then forward is +Z, then right is +X.
-		auto right = cross_product({0, 0, 1}, gravity().normalize()).normalize();
+		auto right = cross_product({0, 0, 1}, gravity.normalize()).normalize();
 
 		// The image Y axis in device space points towards the right when gravity is device space -Y and forward is +Z.
 		//auto angle = right.angle_between({0, 1, 0});
@@ -14,6 +14,11 @@
 #include <Euclid/Numerics/Vector.h>
 #include <Euclid/Numerics/Quaternion.h>
 
+#include "FrameCache.h"
+
+#include <stdexcept>
+#include <typeinfo>
+
 namespace TransformFlow
 {
 	using namespace Dream;
@@ -22,6 +27,7 @@ namespace TransformFlow
 	using namespace Dream::Imaging;
 
 	class MotionModel;
+	class Luminance;
 
 	struct SensorUpdate {
 		virtual ~SensorUpdate();
@@ -68,14 +74,28 @@ namespace TransformFlow
 	};
 
 	struct ImageUpdate : public SensorUpdate {
+		ImageUpdate();
 		virtual ~ImageUpdate();
 		virtual void apply(MotionModel * model);
 		
+		// The image, if it was provided directly. Images from a data set are loaded on demand using the frame cache instead, so use image() to access the image.
 		Ref<Image> image_buffer;
 
+		// The index of the frame in the data set it was loaded from, which identifies the image file.
+		std::size_t frame_index;
+
+		// If set, the image is loaded on demand from the cache when there is no image buffer:
+		Ref<FrameCache> frame_cache;
+
+		// The image buffer, or the frame loaded from the frame cache.
+		Ref<Image> image() const;
+
 		/// The horizontal field of view of the camera image updates:
 		Radians<> field_of_view;
 
+		// The greyscale version of the image, shared by all consumers through LuminanceCache::shared_cache().
+		Ref<Luminance> luminance() const;
+
 		RealT distance_from_origin(RealT width) const;
 		RealT distance_from_origin();
 
@@ -86,13 +106,41 @@ namespace TransformFlow
 	/// A basic motion model interface. The output is gravity, bearing (rotation about gravity from north axis) and position.
 	class MotionModel : public Object
 	{
+		public:
+			// A copy of the state of a motion model, so that it can continue processing updates from the same point later, e.g. to resume a replay from a checkpoint. Each model extends the snapshot of the model it's derived from.
+			struct Snapshot : public Object
+			{
+				virtual ~Snapshot();
+
+				Vec3 camera_axis;
+			};
+
 		protected:
 			Vec3 _camera_axis;
+
+			void save(Snapshot & snapshot) const;
+			void load(const Snapshot & snapshot);
+
+			// Throws std::invalid_argument unless the snapshot was taken from the same kind of model.
+			template <typename SnapshotT>
+			static const SnapshotT & snapshot_cast(const Snapshot & snapshot)
+			{
+				if (typeid(snapshot) != typeid(SnapshotT))
+					throw std::invalid_argument("Snapshot was taken from a different kind of motion model!");
+
+				return static_cast<const SnapshotT &>(snapshot);
+			}
 		
 		public:
 			MotionModel();
 			virtual ~MotionModel();
 
+			// Capture the current state. Parameters given to the constructor are not included, so a snapshot should be restored into a model which was constructed the same way. Snapshots are independent of the model, which can continue to be updated.
+			virtual Ref<Snapshot> snapshot() = 0;
+
+			// Replace the current state with a snapshot. Throws std::invalid_argument if the snapshot was taken from a different kind of model.
+			virtual void restore(const Snapshot & snapshot) = 0;
+
 			void update(SensorUpdate * sensor_update);
 
 			virtual void update(const LocationUpdate & location_update) = 0;
@@ -100,16 +148,25 @@ namespace TransformFlow
 			virtual void update(const MotionUpdate & motion_update) = 0;
 			virtual void update(const ImageUpdate & image_update) = 0;
 
+			// Apply a run of consecutive motion updates, e.g. the gyro samples between two frames. Equivalent to applying each of them in order, which is what this does unless a model can integrate them more efficiently.
+			virtual void update(const MotionUpdate * motion_updates, std::size_t count);
+
 			Radians<> tilt() const;
 
 			// Returns whether the motion model is valid for tracking.
 			virtual bool localization_valid() const;
 
+			// Whether image updates need their images, otherwise only their timing is used, so the images don't need to be loaded. Models are assumed to use images unless they say otherwise.
+			virtual bool uses_images() const;
+
 			virtual const Vec3 & gravity() const = 0;
 			virtual const Vec3 & position() const = 0;
 			virtual Radians<> bearing() const = 0;
 	};
 	
+	// The rotation of the image about the camera axis, given the gravity vector in device coordinates, see MotionModel::tilt().
+	Radians<> device_tilt(const Vec3 & gravity);
+
 	// Compute the rotation from device coordinates to global coordinates, based on the given motion model.
 	Quat local_camera_transform(const Vec3 & gravity, const Radians<> & bearing);
 
@@ -7,6 +7,7 @@
 //
 
 #include "OpticalFlowMotionModel.h"
+#include "LuminanceCache.h"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/features2d/features2d.hpp>
@@ -25,10 +26,9 @@ namespace TransformFlow
 		std::clock_t start = std::clock();
 
 		Vec3u size = pixel_buffer->size();
-		cv::Mat color_frame(size[Y], size[X], CV_8UC4, (void*)pixel_buffer->data());
-		cv::Mat greyscale_frame(size[Y], size[X], CV_8UC1);
 
-		cv::cvtColor(color_frame, greyscale_frame, CV_RGB2GRAY);
+		Ref<Luminance> luminance = LuminanceCache::shared_cache()->luminance_for(pixel_buffer);
+		const cv::Mat & greyscale_frame = luminance->pixels();
 
 		//cv::GoodFeaturesToTrackDetector feature_detector(400);
 		//cv::FastFeatureDetector feature_detector(20);
@@ -65,6 +65,34 @@ namespace TransformFlow
 	{
 	}
 
+	Ref<MotionModel::Snapshot> OpticalFlowMotionModel::snapshot()
+	{
+		Ref<Snapshot> snapshot = new Snapshot;
+		save(*snapshot);
+
+		snapshot->previous_bearing = _previous_bearing;
+		snapshot->image_primed = _image_primed;
+		snapshot->image_update = _image_update;
+
+		return snapshot;
+	}
+
+	void OpticalFlowMotionModel::restore(const MotionModel::Snapshot & snapshot)
+	{
+		const Snapshot & optical_flow_snapshot = snapshot_cast<Snapshot>(snapshot);
+
+		load(optical_flow_snapshot);
+
+		_previous_bearing = optical_flow_snapshot.previous_bearing;
+		_image_primed = optical_flow_snapshot.image_primed;
+		_image_update = optical_flow_snapshot.image_update;
+	}
+
+	bool OpticalFlowMotionModel::uses_images() const
+	{
+		return true;
+	}
+
 	void OpticalFlowMotionModel::update(const ImageUpdate & image_update)
 	{
 		if (_image_primed)
@@ -78,7 +106,7 @@ namespace TransformFlow
 			auto transform = _matching_algorithm->calculate_local_transform(_image_update, image_update);
 		}
 
-		_previous_bearing = _bearing;
+		_previous_bearing = _fusion.bearing();
 
 		_image_primed = true;
 		_image_update = image_update;
@@ -23,6 +23,18 @@ namespace TransformFlow
 		virtual ~OpticalFlowMotionModel();
 
 		virtual void update(const ImageUpdate & image_update);
+		virtual bool uses_images() const;
+
+		struct Snapshot : public BasicSensorMotionModel::Snapshot
+		{
+			RealT previous_bearing;
+
+			bool image_primed;
+			ImageUpdate image_update;
+		};
+
+		virtual Ref<MotionModel::Snapshot> snapshot();
+		virtual void restore(const MotionModel::Snapshot & snapshot);
 
 	private:
 		RealT _previous_bearing;
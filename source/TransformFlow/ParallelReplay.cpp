@@ -0,0 +1,228 @@
+//
+//  ParallelReplay.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "ParallelReplay.h"
+
+#include <Dream/Core/Timer.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace TransformFlow
+{
+	// The decoded images which haven't yet been used by every model. The images are published in order by the thread which decodes them, and frame i can be released once every model has finished with it.
+	class ParallelReplay::FrameWindow
+	{
+	public:
+		FrameWindow(std::size_t consumers, std::size_t size) : _size(size), _first(0), _consumed(consumers, 0), _finished(0)
+		{
+		}
+
+		// Wait until there is room in the window, and add the next image. Returns false if every model has finished, so there's no need to decode any more images.
+		bool publish(Ref<Image> image)
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+
+			_condition.wait(lock, [&]{return _images.size() < _size || _finished == _consumed.size();});
+
+			if (_finished == _consumed.size())
+				return false;
+
+			_images.push_back(image);
+			_condition.notify_all();
+
+			return true;
+		}
+
+		// Decoding failed, so there won't be any more images.
+		void abort(std::exception_ptr error)
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+
+			_error = error;
+			_condition.notify_all();
+		}
+
+		// Wait until the given frame has been decoded. Rethrows the error if decoding failed before it.
+		Ref<Image> acquire(std::size_t frame)
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+
+			_condition.wait(lock, [&]{return frame < _first + _images.size() || _error;});
+
+			if (frame >= _first + _images.size())
+				std::rethrow_exception(_error);
+
+			return _images[frame - _first];
+		}
+
+		// The consumer has finished with all frames up to and including the given frame.
+		void release(std::size_t consumer, std::size_t frame)
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+
+			_consumed[consumer] = frame + 1;
+			trim();
+		}
+
+		// The consumer doesn't need any more frames.
+		void finish(std::size_t consumer)
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+
+			_consumed[consumer] = std::numeric_limits<std::size_t>::max();
+			_finished += 1;
+
+			trim();
+		}
+
+		// Wait until every consumer has finished.
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+
+			_condition.wait(lock, [&]{return _finished == _consumed.size();});
+		}
+
+	protected:
+		std::size_t _size;
+
+		std::mutex _lock;
+		std::condition_variable _condition;
+
+		// The image of frame _first is at the front:
+		std::deque<Ref<Image>> _images;
+		std::size_t _first;
+
+		// The number of frames each consumer has finished with:
+		std::vector<std::size_t> _consumed;
+		std::size_t _finished;
+
+		std::exception_ptr _error;
+
+		void trim()
+		{
+			std::size_t consumed = *std::min_element(_consumed.begin(), _consumed.end());
+
+			while (!_images.empty() && _first < consumed) {
+				_images.pop_front();
+				_first += 1;
+			}
+
+			_condition.notify_all();
+		}
+	};
+
+	ParallelReplay::ParallelReplay(Ptr<ILoader> loader, Ref<ThreadPool> thread_pool, std::size_t window) : ParallelReplay(new SensorData(loader), thread_pool, window)
+	{
+	}
+
+	ParallelReplay::ParallelReplay(Ref<SensorData> sensor_data, Ref<ThreadPool> thread_pool, std::size_t window) : _sensor_data(sensor_data), _thread_pool(thread_pool), _window(std::max<std::size_t>(window, 1))
+	{
+		if (!_thread_pool)
+			_thread_pool = new ThreadPool;
+	}
+
+	ParallelReplay::~ParallelReplay()
+	{
+	}
+
+	std::vector<ParallelReplay::Result> ParallelReplay::run(const std::vector<Ref<MotionModel>> & motion_models)
+	{
+		std::vector<Result> results(motion_models.size());
+
+		if (motion_models.empty())
+			return results;
+
+		FrameWindow frame_window(motion_models.size(), _window);
+		std::exception_ptr error;
+
+		{
+			// One thread per model, which is finished with before the window goes away:
+			Ref<ThreadPool> model_threads = new ThreadPool(motion_models.size());
+
+			for (std::size_t i = 0; i < motion_models.size(); i += 1) {
+				results[i].motion_model = motion_models[i];
+
+				model_threads->add(std::bind(&ParallelReplay::replay, this, i, std::ref(frame_window), std::ref(results[i])));
+			}
+
+			// Each image is decoded once, on the thread pool, and handed over to the models in order. Up to window images are decoded ahead of those in the frame window:
+			FramePrefetcher prefetcher(_sensor_data->sensor_updates(), _thread_pool, _window);
+			std::size_t frame_count = _sensor_data->index()->frame_count();
+
+			try {
+				// A frame without an image, e.g. one which wasn't stored in the data set, is null, so it's published like any other frame rather than ending the stream:
+				for (std::size_t frame = 0; frame < frame_count; frame += 1) {
+					if (!frame_window.publish(prefetcher.next()))
+						break;
+				}
+			} catch (...) {
+				error = std::current_exception();
+				frame_window.abort(error);
+			}
+
+			frame_window.wait();
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+
+		return results;
+	}
+
+	void ParallelReplay::replay(std::size_t index, FrameWindow & frame_window, Result & result)
+	{
+		Stopwatch update_watch, wait_watch;
+
+		MotionModel & motion_model = *result.motion_model;
+		std::size_t frame_index = 0;
+
+		try {
+			for (auto & sensor_update : _sensor_data->sensor_updates()) {
+				if (Shared<ImageUpdate> image_update = sensor_update) {
+					wait_watch.start();
+					Ref<Image> image = frame_window.acquire(frame_index);
+					wait_watch.pause();
+
+					// The model gets its own copy of the image update, with the decoded image, so it doesn't need the frame cache. If the frame has no image, the model gets none, rather than loading it again:
+					ImageUpdate model_image_update = *image_update;
+					model_image_update.image_buffer = image;
+					model_image_update.frame_cache = nullptr;
+
+					update_watch.start();
+					motion_model.update(model_image_update);
+
+					VideoStream::VideoFrame video_frame;
+					video_frame.index = frame_index;
+					video_frame.capture(motion_model);
+					update_watch.pause();
+
+					// The frame keeps the notes, but not the image, which is released once every model has finished with it:
+					model_image_update.image_buffer = nullptr;
+					model_image_update.frame_cache = image_update->frame_cache;
+					video_frame.image_update = new ImageUpdate(model_image_update);
+
+					result.frames.push_back(video_frame);
+
+					frame_window.release(index, frame_index);
+					frame_index += 1;
+				} else {
+					update_watch.start();
+					motion_model.update(sensor_update.get());
+					update_watch.pause();
+				}
+			}
+		} catch (...) {
+			result.error = std::current_exception();
+		}
+
+		result.update_time = update_watch.time();
+		result.wait_time = wait_watch.time();
+
+		frame_window.finish(index);
+	}
+}
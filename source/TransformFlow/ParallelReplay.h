@@ -0,0 +1,61 @@
+//
+//  ParallelReplay.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_PARALLELREPLAY_H
+#define TRANSFORMFLOW_PARALLELREPLAY_H
+
+#include "VideoStream.h"
+
+#include <exception>
+
+namespace TransformFlow
+{
+	/*
+		Replays one data set through several motion models at once, e.g. to compare different models, or the same model with different parameters. The log is parsed once and each image is decoded once, rather than once per model.
+
+		Each model runs on its own thread. Images are decoded in order on the thread pool, and the decoded images are shared, read only, by all the models. At most window images are held for the models, so the fastest model waits for the slowest one, and up to window more are decoded ahead of them, so about twice window decoded images are in memory at once. The frame cache of the sensor data may also keep recently decoded images, within its budget. Each model gets its own copy of every image update, so that notes added by one model aren't seen by the others.
+	 */
+	class ParallelReplay : public Object
+	{
+	public:
+		struct Result
+		{
+			Ref<MotionModel> motion_model;
+
+			// The same as VideoStream::frames(), but without feature points, as they don't depend on the model. Each frame has the copy of the image update given to the model, without its image.
+			std::vector<VideoStream::VideoFrame> frames;
+
+			// The time spent updating the model, and waiting for images to be decoded:
+			TimeT update_time, wait_time;
+
+			// If the model threw an exception, the remaining updates were skipped:
+			std::exception_ptr error;
+		};
+
+		// If no thread pool is given, one is created for decoding images.
+		ParallelReplay(Ptr<ILoader> loader, Ref<ThreadPool> thread_pool = nullptr, std::size_t window = 8);
+		ParallelReplay(Ref<SensorData> sensor_data, Ref<ThreadPool> thread_pool = nullptr, std::size_t window = 8);
+		virtual ~ParallelReplay();
+
+		Ref<SensorData> sensor_data() const { return _sensor_data; }
+
+		// The number of images held for the models, which is also the number decoded ahead of them.
+		std::size_t window() const { return _window; }
+
+		// Replay every update through each of the models, and return once they have all finished. The results are in the same order as the models. If decoding an image fails, the exception is rethrown here once the models have stopped.
+		std::vector<Result> run(const std::vector<Ref<MotionModel>> & motion_models);
+
+	protected:
+		Ref<SensorData> _sensor_data;
+		Ref<ThreadPool> _thread_pool;
+		std::size_t _window;
+
+		class FrameWindow;
+
+		void replay(std::size_t index, FrameWindow & frame_window, Result & result);
+	};
+}
+
+#endif
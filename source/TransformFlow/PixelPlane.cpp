@@ -0,0 +1,27 @@
+//
+//  PixelPlane.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "PixelPlane.h"
+
+namespace TransformFlow
+{
+	PixelPlane PixelPlane::for_image(Ptr<Image> image)
+	{
+		PixelPlane plane;
+
+		plane.data = image->data();
+		plane.width = image->size()[WIDTH];
+		plane.height = image->size()[HEIGHT];
+		plane.channels = image->layout().channel_count();
+		plane.stride = plane.width * plane.channels;
+
+		return plane;
+	}
+
+	PixelPlane PixelPlane::for_luma(const ByteT * luma, std::size_t width, std::size_t height, std::size_t stride)
+	{
+		return {luma, width, height, stride, 1};
+	}
+}
@@ -0,0 +1,74 @@
+//
+//  PixelPlane.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_PIXELPLANE_H
+#define TRANSFORMFLOW_PIXELPLANE_H
+
+#include <Dream/Imaging/Image.h>
+
+namespace TransformFlow
+{
+	using namespace Dream;
+	using namespace Dream::Imaging;
+	using namespace Euclid::Numerics;
+
+	// Interleaved 8-bit pixels with the given number of channels. Intensity is the average of the colour channels, ignoring alpha.
+	template <std::size_t CHANNELS>
+	struct PackedPixel
+	{
+		static const std::size_t channels = CHANNELS;
+
+		static inline RealT intensity(const ByteT * pixel)
+		{
+			if (CHANNELS >= 3)
+				return RealT(pixel[0] + pixel[1] + pixel[2]) / 3.0;
+			else
+				return pixel[0];
+		}
+	};
+
+	typedef PackedPixel<1> GreyPixel;
+	typedef PackedPixel<2> GreyAlphaPixel;
+	typedef PackedPixel<3> RGBPixel;
+	typedef PackedPixel<4> RGBAPixel;
+
+	// A read-only view of 8-bit pixel data with the origin in the top left. Rows may be padded, and the plane may be part of a larger buffer, e.g. the luma plane of an NV12 or YUV420 camera frame, which can then be processed without copying or colour conversion.
+	struct PixelPlane
+	{
+		const ByteT * data;
+
+		std::size_t width, height;
+
+		// The number of bytes between the start of successive rows:
+		std::size_t stride;
+
+		// The number of interleaved 8-bit channels per pixel, from 1 to 4:
+		std::size_t channels;
+
+		const ByteT * pixel(std::size_t x, std::size_t y) const { return data + y * stride + x * channels; }
+
+		// A plane viewing the pixels of a packed image.
+		static PixelPlane for_image(Ptr<Image> image);
+
+		// A greyscale plane viewing the luma (Y) plane of a bi-planar or planar YUV 4:2:0 buffer. The chroma planes are ignored.
+		static PixelPlane for_luma(const ByteT * luma, std::size_t width, std::size_t height, std::size_t stride);
+	};
+
+	// Calls callback(PixelT()) with the pixel type matching the layout of the plane, so that the callback can be specialised at compile time. Returns false if the layout is not supported.
+	template <typename CallbackT>
+	bool dispatch_pixel_type(const PixelPlane & plane, CallbackT && callback)
+	{
+		switch (plane.channels) {
+			case 1: callback(GreyPixel()); return true;
+			case 2: callback(GreyAlphaPixel()); return true;
+			case 3: callback(RGBPixel()); return true;
+			case 4: callback(RGBAPixel()); return true;
+		}
+
+		return false;
+	}
+}
+
+#endif
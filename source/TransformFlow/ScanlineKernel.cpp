@@ -0,0 +1,218 @@
+//
+//  ScanlineKernel.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "ScanlineKernel.h"
+
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define TRANSFORM_FLOW_X86_KERNELS
+	#include <immintrin.h>
+#endif
+
+namespace TransformFlow
+{
+	// The laplacian is computed over 5 samples, so the first and last two samples don't have a value:
+	static const std::size_t MARGIN = 2;
+
+	static inline RealT laplacian(const RealT * v, std::size_t i)
+	{
+		// The order of operations must match the vectorised kernels exactly, otherwise the results are not bit-identical.
+		RealT sum = v[i] * 4;
+
+		sum += -v[i-1];
+		sum += -v[i+1];
+		sum += -v[i-2];
+		sum += -v[i+2];
+
+		return sum;
+	}
+
+	static inline bool good_edge(const RealT * v, std::size_t index)
+	{
+		// The squared difference between the left, center and right of the edge. Found this to be the most robust:
+		auto ia = (v[index-2] + v[index-1]) / 2.0;
+		auto ib = v[index];
+		auto ic = (v[index+2] + v[index+1]) / 2.0;
+
+		auto dab = (ib - ia), dbc = (ic - ib);
+		RealT d = (dab*dab) + (dbc*dbc);
+
+		return d >= 600;
+	}
+
+	// Given the laplacian at index-1 (a) and index (b), add an edge if there is a zero crossing.
+	static inline void add_edge(const RealT * v, std::size_t index, RealT a, RealT b, std::vector<ScanlineEdge> & edges)
+	{
+		if (a != 0 && b == 0) {
+			// Zero crossing at index (very rare).
+			if (good_edge(v, index))
+				edges.push_back({index, 0, true});
+		} else if ((a < 0 && b > 0) || (b < 0 && a > 0)) {
+			// Midpoint between index-1 and index.
+			if (good_edge(v, index))
+				edges.push_back({index, -a / (b - a), false});
+		}
+	}
+
+	static void find_edges_scalar(const RealT * v, std::size_t first, std::size_t last, std::vector<ScanlineEdge> & edges)
+	{
+		if (first >= last) return;
+
+		RealT a = laplacian(v, first - 1);
+
+		for (std::size_t i = first; i < last; i += 1) {
+			RealT b = laplacian(v, i);
+
+			add_edge(v, i, a, b, edges);
+
+			a = b;
+		}
+	}
+
+#ifdef TRANSFORM_FLOW_X86_KERNELS
+	__attribute__((target("sse4.1")))
+	static inline __m128 laplacian_sse4(const float * v)
+	{
+		__m128 sum = _mm_mul_ps(_mm_loadu_ps(v), _mm_set1_ps(4));
+
+		sum = _mm_sub_ps(sum, _mm_loadu_ps(v-1));
+		sum = _mm_sub_ps(sum, _mm_loadu_ps(v+1));
+		sum = _mm_sub_ps(sum, _mm_loadu_ps(v-2));
+		sum = _mm_sub_ps(sum, _mm_loadu_ps(v+2));
+
+		return sum;
+	}
+
+	__attribute__((target("sse4.1")))
+	static std::size_t find_edges_sse4(const float * v, std::size_t first, std::size_t last, std::vector<ScanlineEdge> & edges)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		alignas(16) float as[4], bs[4];
+
+		std::size_t i = first;
+
+		for (; i + 4 <= last; i += 4) {
+			__m128 a = laplacian_sse4(v + i - 1);
+			__m128 b = laplacian_sse4(v + i);
+
+			__m128 exact = _mm_and_ps(_mm_cmpneq_ps(a, zero), _mm_cmpeq_ps(b, zero));
+			__m128 rising = _mm_and_ps(_mm_cmplt_ps(a, zero), _mm_cmpgt_ps(b, zero));
+			__m128 falling = _mm_and_ps(_mm_cmpgt_ps(a, zero), _mm_cmplt_ps(b, zero));
+
+			int mask = _mm_movemask_ps(_mm_or_ps(exact, _mm_or_ps(rising, falling)));
+
+			if (mask) {
+				_mm_store_ps(as, a);
+				_mm_store_ps(bs, b);
+
+				for (std::size_t lane = 0; lane < 4; lane += 1) {
+					if (mask & (1 << lane))
+						add_edge(v, i + lane, as[lane], bs[lane], edges);
+				}
+			}
+		}
+
+		return i;
+	}
+
+	__attribute__((target("avx2")))
+	static inline __m256 laplacian_avx2(const float * v)
+	{
+		__m256 sum = _mm256_mul_ps(_mm256_loadu_ps(v), _mm256_set1_ps(4));
+
+		sum = _mm256_sub_ps(sum, _mm256_loadu_ps(v-1));
+		sum = _mm256_sub_ps(sum, _mm256_loadu_ps(v+1));
+		sum = _mm256_sub_ps(sum, _mm256_loadu_ps(v-2));
+		sum = _mm256_sub_ps(sum, _mm256_loadu_ps(v+2));
+
+		return sum;
+	}
+
+	__attribute__((target("avx2")))
+	static std::size_t find_edges_avx2(const float * v, std::size_t first, std::size_t last, std::vector<ScanlineEdge> & edges)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+
+		alignas(32) float as[8], bs[8];
+
+		std::size_t i = first;
+
+		for (; i + 8 <= last; i += 8) {
+			__m256 a = laplacian_avx2(v + i - 1);
+			__m256 b = laplacian_avx2(v + i);
+
+			__m256 exact = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(b, zero, _CMP_EQ_OQ));
+			__m256 rising = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_LT_OQ), _mm256_cmp_ps(b, zero, _CMP_GT_OQ));
+			__m256 falling = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ), _mm256_cmp_ps(b, zero, _CMP_LT_OQ));
+
+			int mask = _mm256_movemask_ps(_mm256_or_ps(exact, _mm256_or_ps(rising, falling)));
+
+			if (mask) {
+				_mm256_store_ps(as, a);
+				_mm256_store_ps(bs, b);
+
+				for (std::size_t lane = 0; lane < 8; lane += 1) {
+					if (mask & (1 << lane))
+						add_edge(v, i + lane, as[lane], bs[lane], edges);
+				}
+			}
+		}
+
+		return i;
+	}
+#endif
+
+	bool kernel_supported(ScanlineKernel kernel)
+	{
+		switch (kernel) {
+			case ScanlineKernel::AUTOMATIC:
+			case ScanlineKernel::SCALAR:
+				return true;
+
+#ifdef TRANSFORM_FLOW_X86_KERNELS
+			// The vectorised kernels only work with single precision intensities:
+			case ScanlineKernel::SSE4:
+				return std::is_same<RealT, float>::value && __builtin_cpu_supports("sse4.1");
+			case ScanlineKernel::AVX2:
+				return std::is_same<RealT, float>::value && __builtin_cpu_supports("avx2");
+#endif
+
+			default:
+				return false;
+		}
+	}
+
+	ScanlineKernel best_kernel()
+	{
+		static const ScanlineKernel kernel = kernel_supported(ScanlineKernel::AVX2) ? ScanlineKernel::AVX2 : kernel_supported(ScanlineKernel::SSE4) ? ScanlineKernel::SSE4 : ScanlineKernel::SCALAR;
+
+		return kernel;
+	}
+
+	void find_edges_along_scanline(const RealT * intensities, std::size_t count, std::vector<ScanlineEdge> & edges, ScanlineKernel kernel)
+	{
+		// We need the laplacian at index-1 and index, and the laplacian needs MARGIN samples either side:
+		if (count < (MARGIN * 2 + 2)) return;
+
+		std::size_t first = MARGIN + 1, last = count - MARGIN;
+
+		if (kernel == ScanlineKernel::AUTOMATIC || !kernel_supported(kernel))
+			kernel = best_kernel();
+
+#ifdef TRANSFORM_FLOW_X86_KERNELS
+		// The vectorised kernels process as many full blocks as possible, and the remainder is handled by the scalar kernel:
+		const float * v = reinterpret_cast<const float *>(intensities);
+
+		if (kernel == ScanlineKernel::AVX2)
+			first = find_edges_avx2(v, first, last, edges);
+		else if (kernel == ScanlineKernel::SSE4)
+			first = find_edges_sse4(v, first, last, edges);
+#endif
+
+		find_edges_scalar(intensities, first, last, edges);
+	}
+}
@@ -0,0 +1,43 @@
+//
+//  ScanlineKernel.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_SCANLINEKERNEL_H
+#define TRANSFORMFLOW_SCANLINEKERNEL_H
+
+#include <Euclid/Numerics/Numerics.h>
+
+#include <vector>
+
+namespace TransformFlow
+{
+	using namespace Euclid::Numerics;
+
+	// The implementations of the scanline edge detector. All kernels produce identical edges, they only differ in speed. AUTOMATIC selects the fastest kernel supported by the processor at runtime.
+	enum class ScanlineKernel
+	{
+		AUTOMATIC,
+		SCALAR,
+		SSE4,
+		AVX2
+	};
+
+	struct ScanlineEdge
+	{
+		// The sample index of the edge. If the edge is exact, it is located at index, otherwise it is located between index-1 and index, at the given fraction.
+		std::size_t index;
+		RealT fraction;
+		bool exact;
+	};
+
+	bool kernel_supported(ScanlineKernel kernel);
+
+	// Returns the fastest supported kernel, never AUTOMATIC.
+	ScanlineKernel best_kernel();
+
+	// Finds the zero crossings of the 5-tap laplacian along a contiguous scanline of intensities, keeping only those with a sufficiently strong gradient. Edges are appended in order of increasing index.
+	void find_edges_along_scanline(const RealT * intensities, std::size_t count, std::vector<ScanlineEdge> & edges, ScanlineKernel kernel = ScanlineKernel::AUTOMATIC);
+}
+
+#endif
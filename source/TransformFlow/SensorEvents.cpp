@@ -0,0 +1,53 @@
+//
+//  SensorEvents.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "SensorEvents.h"
+
+namespace TransformFlow
+{
+	SensorEvents::SensorEvents()
+	{
+	}
+
+	SensorEvents::SensorEvents(SensorStream & sensor_stream)
+	{
+		if (Ref<Dataset> dataset = sensor_stream.dataset()) {
+			_events.reserve(dataset->event_count());
+			_motion_updates.reserve(dataset->motion_count());
+			_location_updates.reserve(dataset->location_count());
+			_heading_updates.reserve(dataset->heading_count());
+			_image_updates.reserve(dataset->frame_count());
+		}
+
+		while (Shared<SensorUpdate> sensor_update = sensor_stream.next())
+			append(*sensor_update);
+	}
+
+	SensorEvents::~SensorEvents()
+	{
+	}
+
+	void SensorEvents::append(const SensorUpdate & sensor_update)
+	{
+		if (auto motion_update = dynamic_cast<const MotionUpdate *>(&sensor_update)) {
+			_events.push_back({Kind::MOTION, std::uint32_t(_motion_updates.size())});
+			_motion_updates.push_back(*motion_update);
+		} else if (auto location_update = dynamic_cast<const LocationUpdate *>(&sensor_update)) {
+			_events.push_back({Kind::LOCATION, std::uint32_t(_location_updates.size())});
+			_location_updates.push_back(*location_update);
+		} else if (auto heading_update = dynamic_cast<const HeadingUpdate *>(&sensor_update)) {
+			_events.push_back({Kind::HEADING, std::uint32_t(_heading_updates.size())});
+			_heading_updates.push_back(*heading_update);
+		} else if (auto image_update = dynamic_cast<const ImageUpdate *>(&sensor_update)) {
+			_events.push_back({Kind::FRAME, std::uint32_t(_image_updates.size())});
+			_image_updates.push_back(*image_update);
+		}
+	}
+
+	void SensorEvents::apply(MotionModel & motion_model) const
+	{
+		visit(MotionModelVisitor{motion_model});
+	}
+}
@@ -0,0 +1,109 @@
+//
+//  SensorEvents.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_SENSOREVENTS_H
+#define TRANSFORMFLOW_SENSOREVENTS_H
+
+#include "SensorStream.h"
+
+#include <cstdint>
+
+namespace TransformFlow
+{
+	/*
+		Sensor updates stored by value, in one array per kind, with the order kept by a separate array of tagged events. This is the same layout as the binary data set. Compared with a vector of Shared<SensorUpdate>, each update doesn't need its own allocation, replay reads memory sequentially, and updates are dispatched with a switch on the tag rather than SensorUpdate::apply.
+
+		Updates are visited using an overloaded function object, which is given the update of each event, e.g. MotionModelVisitor.
+	 */
+	class SensorEvents : public Object
+	{
+	public:
+		typedef Dataset::Event Kind;
+
+		struct Event
+		{
+			Kind kind;
+
+			// The row in the array for this kind of update:
+			std::uint32_t index;
+		};
+
+		SensorEvents();
+
+		// Read all the remaining updates from the stream.
+		SensorEvents(SensorStream & sensor_stream);
+
+		virtual ~SensorEvents();
+
+		// Copy the update to the end of the store.
+		void append(const SensorUpdate & sensor_update);
+
+		std::size_t size() const { return _events.size(); }
+		const Event & event(std::size_t index) const { return _events[index]; }
+
+		const std::vector<MotionUpdate> & motion_updates() const { return _motion_updates; }
+		const std::vector<LocationUpdate> & location_updates() const { return _location_updates; }
+		const std::vector<HeadingUpdate> & heading_updates() const { return _heading_updates; }
+		const std::vector<ImageUpdate> & image_updates() const { return _image_updates; }
+
+		// Call the visitor with the update of the given event.
+		template <typename VisitorT>
+		void visit(std::size_t index, VisitorT && visitor) const
+		{
+			const Event & event = _events[index];
+
+			switch (event.kind) {
+				case Kind::MOTION:
+					visitor(_motion_updates[event.index]);
+					break;
+
+				case Kind::LOCATION:
+					visitor(_location_updates[event.index]);
+					break;
+
+				case Kind::HEADING:
+					visitor(_heading_updates[event.index]);
+					break;
+
+				case Kind::FRAME:
+					visitor(_image_updates[event.index]);
+					break;
+			}
+		}
+
+		// Call the visitor with every update, in order.
+		template <typename VisitorT>
+		void visit(VisitorT && visitor) const
+		{
+			for (std::size_t index = 0; index < _events.size(); index += 1)
+				visit(index, visitor);
+		}
+
+		// Apply every update to the motion model, in order.
+		void apply(MotionModel & motion_model) const;
+
+	protected:
+		std::vector<Event> _events;
+
+		std::vector<MotionUpdate> _motion_updates;
+		std::vector<LocationUpdate> _location_updates;
+		std::vector<HeadingUpdate> _heading_updates;
+		std::vector<ImageUpdate> _image_updates;
+	};
+
+	// Applies each update it's given to the motion model. This skips SensorUpdate::apply, but each update is still one virtual call to MotionModel::update. A visitor for a concrete model type, e.g. ComposedMotionModel, avoids that too.
+	struct MotionModelVisitor
+	{
+		MotionModel & motion_model;
+
+		template <typename UpdateT>
+		void operator()(const UpdateT & update) const
+		{
+			motion_model.update(update);
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,161 @@
+//
+//  SensorFusion.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_SENSORFUSION_H
+#define TRANSFORMFLOW_SENSORFUSION_H
+
+#include "MotionModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace TransformFlow
+{
+	// If blend = 0, result is a, if blend = 1, result is b.
+	inline double interpolateAnglesRadians(double a, double b, double blend)
+	{
+		double ix = std::sin(a), iy = std::cos(a);
+		double jx = std::sin(b), jy = std::cos(b);
+
+		return std::atan2(ix-(ix-jx)*blend, iy-(iy-jy)*blend);
+	}
+
+	inline double interpolateAnglesDegrees(double a, double b, double blend)
+	{
+		return interpolateAnglesRadians(a * D2R, b * D2R, blend) * R2D;
+	}
+
+	// The bearing of the camera axis, given the compass bearing of device north.
+	RealT normalized_bearing(RealT bearing, const Vec3 & device_north, const Vec3 & gravity, const Vec3 & camera_axis);
+
+	// Fuses the gyroscope and compass into a bearing, as used by BasicSensorMotionModel. The updates are not virtual and are defined here, so that models which are composed from this at compile time can be inlined, see ComposedMotionModel. It can be copied to save its state.
+	class SensorFusion
+	{
+	public:
+		typedef SensorFusion State;
+
+		// How much of the compass bearing is blended into the gyro bearing with each motion update:
+		static constexpr double COMPASS_BLEND = 0.1;
+
+		// The largest difference in bearing, in degrees, between integrating a batch and applying the updates one at a time.
+		static const RealT BATCH_TOLERANCE;
+
+		SensorFusion(const Vec3 & camera_axis = Vec3(0, 0, -1)) : _camera_axis(camera_axis), _gravity(0), _position(0), _bearing(0), _normalized_bearing(0), _heading_primed(false), _bearing_primed(false), _motion_primed(false), _relative_rotation(0), _best_horizontal_accuracy(100)
+		{
+		}
+
+		void update(const LocationUpdate & location_update)
+		{
+			// We bias this a wee bit so that updates with a similar accuracy +/- 50% will be accepted.
+			if (location_update.horizontal_accuracy < _best_horizontal_accuracy * 1.5)
+			{
+				_position[X] = location_update.latitude;
+				_position[Y] = location_update.longitude;
+				_position[Z] = location_update.altitude;
+
+				_best_horizontal_accuracy = std::max<RealT>(location_update.horizontal_accuracy, 20);
+			}
+		}
+
+		void update(const HeadingUpdate & heading_update)
+		{
+			if (_heading_primed == false)
+				_heading_primed = true;
+
+			_heading_update = heading_update;
+
+			// The first time this function is called, it is unlikely we already have a motion update... But if we do, we go here, and for all subsequent updates, we do the processing here.
+			if (_motion_primed)
+				normalize_bearing();
+		}
+
+		void update(const MotionUpdate & motion_update)
+		{
+			_gravity = motion_update.gravity;
+
+			if (_motion_primed) {
+				RealT dt = motion_update.time_offset - _motion_update.time_offset;
+
+				// Calculate the rotation around gravity, rotation rate is in radians/second
+				auto rotation = motion_update.rotation_rate * dt;
+
+				auto rotation_about_gravity = _gravity.dot(rotation);
+
+				// Relative rotation by the gyroscope is saved in radians:
+				_relative_rotation += radians(rotation_about_gravity);
+
+				if (_heading_primed) {
+					_bearing = interpolateAnglesDegrees(_bearing + (rotation_about_gravity * R2D), _normalized_bearing, COMPASS_BLEND);
+				}
+
+				_motion_update = motion_update;
+			} else {
+				_motion_primed = true;
+				_motion_update = motion_update;
+
+				// If we got a heading update, before getting the motion update, when we get the motion update we want to update the normalized bearing if required.
+				if (_heading_primed)
+					normalize_bearing();
+			}
+		}
+
+		// Integrates the gyro for the whole batch, and blends the bearing with the compass using unit vectors, rather than converting to and from angles for each update. The result is within BATCH_TOLERANCE of applying each update in order, because the bearing isn't rounded to RealT after every update. The relative rotation is accumulated in the same way, so it's the same.
+		void update(const MotionUpdate * motion_updates, std::size_t count);
+
+		// We need to know the heading and motion at least once before the localization becomes valid.
+		bool primed() const { return _heading_primed && _motion_primed; }
+
+		const Vec3 & gravity() const { return _gravity; }
+		const Vec3 & position() const { return _position; }
+
+		// Measured in degrees from north.
+		RealT bearing() const { return _bearing; }
+
+		// The rotation about gravity measured by the gyroscope since the first motion update.
+		Radians<> relative_rotation() const { return _relative_rotation; }
+
+		const State & state() const { return *this; }
+		void restore(const State & state) { *this = state; }
+
+	protected:
+		Vec3 _camera_axis;
+
+		Vec3 _gravity, _position;
+
+		// Measured in degrees from north, the _bearing is a fusion between the compass and the gyro, while _normalized_bearing is computed purely from the compass and represents the bearing relative to the _camera_axis.
+		RealT _bearing, _normalized_bearing;
+
+		// State relating to heading updates:
+		bool _heading_primed, _bearing_primed;
+		HeadingUpdate _heading_update;
+
+		// State relating to gyro/motion updates:
+		bool _motion_primed;
+		MotionUpdate _motion_update;
+
+		// The relative rotation as measured from motion update to motion update.
+		Radians<> _relative_rotation;
+
+		// Used for tracking the quality of position updates:
+		RealT _best_horizontal_accuracy;
+
+		// This function computes the normalized bearing from the current heading and motion updates:
+		void normalize_bearing()
+		{
+			// Require heading and gravity:
+			if (!_heading_primed || !_motion_primed) return;
+
+			// We compute the bearing around -Z axis. The bearing is the angle between "north" and "device north". For most phones I've worked with, "device north" is <0, 1, 0>. However, this isn't usually pointing down the camera axis <0, 0, -1> which causes problems for rotations around that axis. We fix this by computing the rotation of the -Z axis.
+			_normalized_bearing = normalized_bearing(_heading_update.true_bearing, _heading_update.device_north, _gravity, _camera_axis);
+
+			if (!_bearing_primed) {
+				_bearing = _normalized_bearing;
+				_bearing_primed = true;
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,223 @@
+//
+//  SensorIndex.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "SensorIndex.h"
+
+#include <Dream/Core/Data.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace TransformFlow
+{
+	using namespace Dream::Events::Logging;
+
+	const char * SensorIndex::RESOURCE_NAME = "index";
+
+	static const char MAGIC[8] = {'T', 'F', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+	// Written as a native integer, so that a file from a machine with a different byte order can be detected:
+	static const std::uint32_t BYTE_ORDER = 0x01020304;
+
+	// The entries follow the header, and the frames follow the entries. Everything is a multiple of 8 bytes, so no padding is needed:
+	struct FileHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+
+		std::uint64_t source_size;
+		std::uint64_t entry_count;
+		std::uint64_t frame_count;
+
+		SensorIndex::Position end;
+	};
+
+	SensorIndex::SensorIndex(SensorStream & sensor_stream, std::function<void(Shared<SensorUpdate>)> callback) : _source_size(sensor_stream.size())
+	{
+		while (true) {
+			Position position = sensor_stream.position();
+			Shared<SensorUpdate> sensor_update = sensor_stream.next();
+
+			if (!sensor_update) {
+				finish(position);
+				break;
+			}
+
+			append(sensor_update->time_offset, position, dynamic_cast<const ImageUpdate *>(sensor_update.get()) != nullptr);
+
+			if (callback)
+				callback(sensor_update);
+		}
+	}
+
+	SensorIndex::SensorIndex(const Dataset & dataset) : _source_size(dataset.size())
+	{
+		typedef Dataset::Event Event;
+
+		Position position = {0, 0, 0, 0, 0};
+
+		_built_entries.reserve(dataset.event_count());
+		_built_frames.reserve(dataset.frame_count());
+
+		// The same positions as SensorStream gives while reading the data set:
+		for (; position.offset < dataset.event_count(); position.offset += 1) {
+			switch (dataset.event(position.offset)) {
+				case Event::MOTION:
+					append(dataset.motion_update(position.motions).time_offset, position, false);
+					position.motions += 1;
+					break;
+
+				case Event::LOCATION:
+					append(dataset.location_update(position.locations).time_offset, position, false);
+					position.locations += 1;
+					break;
+
+				case Event::HEADING:
+					append(dataset.heading_update(position.headings).time_offset, position, false);
+					position.headings += 1;
+					break;
+
+				case Event::FRAME:
+					append(dataset.image_update(position.frames).time_offset, position, true);
+					position.frames += 1;
+					break;
+			}
+		}
+
+		finish(position);
+	}
+
+	void SensorIndex::append(double time_offset, const Position & position, bool frame)
+	{
+		if (!_built_entries.empty() && time_offset < _built_entries.back().time_offset)
+			time_offset = _built_entries.back().time_offset;
+
+		if (frame)
+			_built_frames.push_back(_built_entries.size());
+
+		_built_entries.push_back({time_offset, position});
+	}
+
+	void SensorIndex::finish(const Position & end)
+	{
+		_end = end;
+
+		_entries = _built_entries.data();
+		_entry_count = _built_entries.size();
+
+		_frames = _built_frames.data();
+		_frame_count = _built_frames.size();
+	}
+
+	SensorIndex::SensorIndex(Shared<Buffer> buffer) : _buffer(buffer)
+	{
+		const ByteT * data = buffer->begin();
+		std::size_t size = buffer->size();
+
+		if (size < sizeof(FileHeader))
+			throw std::runtime_error("Index is too small!");
+
+		const FileHeader * header = reinterpret_cast<const FileHeader *>(data);
+
+		if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw std::runtime_error("Index has invalid header!");
+
+		if (header->byte_order != BYTE_ORDER)
+			throw std::runtime_error("Index has different byte order!");
+
+		if (header->version != VERSION)
+			throw std::runtime_error("Index has unsupported version!");
+
+		std::size_t available = size - sizeof(FileHeader);
+
+		if (header->entry_count > available / sizeof(Entry) || header->frame_count > (available - header->entry_count * sizeof(Entry)) / sizeof(std::uint64_t))
+			throw std::runtime_error("Index is truncated!");
+
+		_entries = reinterpret_cast<const Entry *>(data + sizeof(FileHeader));
+		_entry_count = header->entry_count;
+
+		_frames = reinterpret_cast<const std::uint64_t *>(_entries + _entry_count);
+		_frame_count = header->frame_count;
+
+		_end = header->end;
+		_source_size = header->source_size;
+	}
+
+	SensorIndex::~SensorIndex()
+	{
+	}
+
+	Ref<SensorIndex> SensorIndex::load(Ptr<ILoader> loader)
+	{
+		Ref<SensorStream> sensor_stream = new SensorStream(loader);
+
+		if (Ref<IData> data = loader->data_for_resource(RESOURCE_NAME)) {
+			try {
+				Ref<SensorIndex> index = new SensorIndex(data->buffer());
+
+				if (index->source_size() == sensor_stream->size())
+					return index;
+
+				log_debug("Index is out of date, rebuilding it.");
+			} catch (std::runtime_error & error) {
+				log_debug("Could not read index:", error.what());
+			}
+		}
+
+		if (Ref<Dataset> dataset = sensor_stream->dataset())
+			return new SensorIndex(*dataset);
+
+		return new SensorIndex(*sensor_stream);
+	}
+
+	std::size_t SensorIndex::entry_for_time(TimeT time_offset) const
+	{
+		const Entry * entry = std::lower_bound(_entries, _entries + _entry_count, time_offset, [](const Entry & entry, TimeT time_offset) {
+			return entry.time_offset < time_offset;
+		});
+
+		return entry - _entries;
+	}
+
+	std::size_t SensorIndex::entry_for_frame(std::size_t frame) const
+	{
+		if (frame >= _frame_count)
+			throw std::out_of_range("Frame is not in the index!");
+
+		return _frames[frame];
+	}
+
+	SensorIndex::Position SensorIndex::position_for_time(TimeT time_offset) const
+	{
+		std::size_t entry = entry_for_time(time_offset);
+
+		if (entry == _entry_count)
+			return _end;
+
+		return _entries[entry].position;
+	}
+
+	void SensorIndex::write(std::ostream & output) const
+	{
+		FileHeader header;
+		std::memset(&header, 0, sizeof(header));
+
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.byte_order = BYTE_ORDER;
+
+		header.source_size = _source_size;
+		header.entry_count = _entry_count;
+		header.frame_count = _frame_count;
+
+		header.end = _end;
+
+		output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char *>(_entries), sizeof(Entry) * _entry_count);
+		output.write(reinterpret_cast<const char *>(_frames), sizeof(std::uint64_t) * _frame_count);
+	}
+}
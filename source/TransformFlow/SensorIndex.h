@@ -0,0 +1,100 @@
+//
+//  SensorIndex.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_SENSORINDEX_H
+#define TRANSFORMFLOW_SENSORINDEX_H
+
+#include "SensorStream.h"
+
+#include <functional>
+#include <ostream>
+
+namespace TransformFlow
+{
+	/*
+		The position of every update in a data set, so that a SensorStream can seek to a time offset or frame without reading the log up to it. Both are found with a binary search.
+
+		Building an index reads the whole data set once, so it can be saved as a sidecar file next to the log, which is memory mapped when it's opened again. The sidecar records the size of the data set it was built from, and is ignored if it doesn't match.
+	 */
+	class SensorIndex : public Object
+	{
+	public:
+		// The name of the sidecar resource, e.g. "index.bin".
+		static const char * RESOURCE_NAME;
+
+		static const std::uint32_t VERSION = 1;
+
+		typedef SensorStream::Position Position;
+
+		struct Entry
+		{
+			// Times are made non-decreasing, so updates which arrive slightly out of order can still be searched:
+			double time_offset;
+
+			Position position;
+		};
+
+		// Build an index by reading the stream from its current position to the end. Each update is also passed to the callback, if given, so that updates can be loaded while they are being indexed.
+		SensorIndex(SensorStream & sensor_stream, std::function<void(Shared<SensorUpdate>)> callback = nullptr);
+
+		// Build an index from the event column of a binary data set, without reading the updates themselves.
+		SensorIndex(const Dataset & dataset);
+
+		// Open a memory mapped sidecar, which is kept until this is released. Only the header is read, so this takes constant time. Throws std::runtime_error if the data isn't a valid index.
+		SensorIndex(Shared<Buffer> buffer);
+
+		virtual ~SensorIndex();
+
+		// Load the sidecar if it is up to date, otherwise build the index from the binary data set or log.
+		static Ref<SensorIndex> load(Ptr<ILoader> loader);
+
+		// The size of the data set which was indexed.
+		std::size_t source_size() const { return _source_size; }
+
+		std::size_t size() const { return _entry_count; }
+		const Entry & entry(std::size_t index) const { return _entries[index]; }
+
+		std::size_t frame_count() const { return _frame_count; }
+
+		// The position after the last update.
+		const Position & end() const { return _end; }
+
+		// The entry of the first update at or after the given time, or size() if there isn't one. Entries are in the same order as the updates, so this is also the number of updates before it.
+		std::size_t entry_for_time(TimeT time_offset) const;
+
+		// The entry of the image update for the given frame, i.e. VideoFrame::index. Throws std::out_of_range if there is no such frame.
+		std::size_t entry_for_frame(std::size_t frame) const;
+
+		// The position of the first update at or after the given time, or end() if there isn't one.
+		Position position_for_time(TimeT time_offset) const;
+
+		Position position_for_frame(std::size_t frame) const { return _entries[entry_for_frame(frame)].position; }
+
+		// Write the index as a sidecar file.
+		void write(std::ostream & output) const;
+
+	protected:
+		Shared<Buffer> _buffer;
+
+		// Used when the index was built rather than mapped:
+		std::vector<Entry> _built_entries;
+		std::vector<std::uint64_t> _built_frames;
+
+		const Entry * _entries;
+		std::size_t _entry_count;
+
+		void append(double time_offset, const Position & position, bool frame);
+		void finish(const Position & end);
+
+		// The entry of each image update:
+		const std::uint64_t * _frames;
+		std::size_t _frame_count;
+
+		Position _end;
+		std::size_t _source_size;
+	};
+}
+
+#endif
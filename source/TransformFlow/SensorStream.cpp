@@ -0,0 +1,242 @@
+//
+//  SensorStream.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "SensorStream.h"
+
+#include <Dream/Core/Buffer.h>
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace TransformFlow
+{
+	constexpr const char * GYROSCOPE = "Gyroscope";
+	constexpr const char * ACCELEROMETER = "Accelerometer";
+	constexpr const char * GRAVITY = "Gravity";
+	constexpr const char * MOTION = "Motion";
+	constexpr const char * LOCATION = "Location";
+	constexpr const char * HEADING = "Heading";
+	constexpr const char * FRAME = "Frame";
+
+	// Frame images are stored in separate files, named by frame index. The cache may outlive the stream, so it keeps its own reference to the loader:
+	static Ref<FrameCache> frame_cache_for_files(Ref<ILoader> loader, std::size_t frame_budget)
+	{
+		return new FrameCache([loader](std::size_t index) {
+			return loader->load<Image>(to_string(index));
+		}, frame_budget);
+	}
+
+	// Images stored in a binary data set are indexed by row, which is normally the frame index. Otherwise, the rows are mapped from their frame index the first time a frame isn't in its own row, so opening the data set doesn't read every frame:
+	static Ref<FrameCache> frame_cache_for_dataset(Ref<Dataset> dataset, std::size_t frame_budget)
+	{
+		struct FrameRows
+		{
+			std::once_flag mapped;
+			std::unordered_map<std::size_t, std::size_t> rows;
+		};
+
+		auto frame_rows = std::make_shared<FrameRows>();
+
+		return new FrameCache([dataset, frame_rows](std::size_t index) -> Ref<Image> {
+			if (index < dataset->frame_count() && dataset->image_update(index).frame_index == index)
+				return dataset->load_frame(index);
+
+			std::call_once(frame_rows->mapped, [&]() {
+				for (std::size_t row = 0; row < dataset->frame_count(); row += 1)
+					frame_rows->rows[dataset->image_update(row).frame_index] = row;
+			});
+
+			auto row = frame_rows->rows.find(index);
+
+			if (row == frame_rows->rows.end()) return nullptr;
+
+			return dataset->load_frame(row->second);
+		}, frame_budget);
+	}
+
+	SensorStream::SensorStream(Ptr<ILoader> loader, std::size_t frame_budget) : _loader(loader), _position(), _parser(nullptr, nullptr)
+	{
+		Ref<IData> data = _loader->data_for_resource(Dataset::RESOURCE_NAME);
+
+		if (data) {
+			_dataset = new Dataset(data->buffer());
+
+			if (_dataset->has_frame_data())
+				_frame_cache = frame_cache_for_dataset(_dataset, frame_budget);
+			else
+				_frame_cache = frame_cache_for_files(_loader, frame_budget);
+		} else {
+			// Memory map the log and parse each row in place:
+			_buffer = _loader->data_for_resource("log")->buffer();
+
+			_parser = CSVParser(log_begin(), log_begin() + _buffer->size());
+
+			_frame_cache = frame_cache_for_files(_loader, frame_budget);
+		}
+	}
+
+	SensorStream::~SensorStream()
+	{
+	}
+
+	Shared<SensorUpdate> SensorStream::next()
+	{
+		if (_dataset)
+			return next_from_dataset();
+		else
+			return next_from_log();
+	}
+
+	SensorStream::Position SensorStream::position() const
+	{
+		Position position = _position;
+
+		if (!_dataset)
+			position.offset = _parser.position() - log_begin();
+
+		return position;
+	}
+
+	void SensorStream::seek(const Position & position)
+	{
+		if (_dataset) {
+			if (position.offset > _dataset->event_count() || position.motions > _dataset->motion_count() || position.locations > _dataset->location_count() || position.headings > _dataset->heading_count() || position.frames > _dataset->frame_count())
+				throw std::out_of_range("Position is outside the data set!");
+		} else {
+			if (position.offset > _buffer->size())
+				throw std::out_of_range("Position is outside the log!");
+
+			_parser.seek(log_begin() + position.offset);
+
+			// Rows from before the position don't apply to the next motion update:
+			_motion_update = MotionUpdate();
+		}
+
+		_position = position;
+	}
+
+	std::size_t SensorStream::size() const
+	{
+		if (_dataset)
+			return _dataset->size();
+		else
+			return _buffer->size();
+	}
+
+	Shared<SensorUpdate> SensorStream::next_from_log()
+	{
+		while (_parser.next_row()) {
+			const CSVParser::RowT & parts = _parser.row();
+
+			if (parts.size() < 2)
+				continue;
+
+			switch (parts.at(1).hash())
+			{
+				case hash_name(GYROSCOPE):
+					_motion_update.rotation_rate = Vec3(parts.at(3).to<RealT>(), parts.at(4).to<RealT>(), parts.at(5).to<RealT>());
+					break;
+
+				case hash_name(ACCELEROMETER):
+					_motion_update.acceleration = Vec3(parts.at(3).to<RealT>(), parts.at(4).to<RealT>(), parts.at(5).to<RealT>());
+					break;
+
+				case hash_name(GRAVITY):
+					_motion_update.gravity = Vec3(parts.at(3).to<RealT>(), parts.at(4).to<RealT>(), parts.at(5).to<RealT>());
+					break;
+
+				case hash_name(MOTION):
+					_motion_update.time_offset = parts.at(2).to<TimeT>();
+					_position.motions += 1;
+
+					return new MotionUpdate(_motion_update);
+
+				case hash_name(LOCATION):
+				{
+					LocationUpdate location_update;
+
+					location_update.time_offset = parts.at(2).to<TimeT>();
+					location_update.latitude = parts.at(3).to<double>();
+					location_update.longitude = parts.at(4).to<double>();
+					location_update.altitude = parts.at(5).to<double>();
+
+					location_update.horizontal_accuracy = parts.at(6).to<double>();
+					location_update.vertical_accuracy = parts.at(7).to<double>();
+
+					_position.locations += 1;
+
+					return new LocationUpdate(location_update);
+				}
+
+				case hash_name(HEADING):
+				{
+					HeadingUpdate heading_update;
+
+					heading_update.time_offset = parts.at(2).to<TimeT>();
+					heading_update.magnetic_bearing = parts.at(3).to<double>();
+					heading_update.true_bearing = parts.at(4).to<double>();
+
+					_position.headings += 1;
+
+					return new HeadingUpdate(heading_update);
+				}
+
+				case hash_name(FRAME):
+				{
+					ImageUpdate image_update;
+
+					image_update.time_offset = parts.at(2).to<RealT>();
+					image_update.frame_index = parts.at(3).to<std::size_t>();
+					image_update.frame_cache = _frame_cache;
+
+					// http://www.boinx.com/chronicles/2013/3/22/field-of-view-fov-of-cameras-in-ios-devices/
+					if (parts.size() >= 5)
+						image_update.field_of_view = radians(parts.at(4).to<RealT>());
+					else
+						image_update.field_of_view = 55.0_deg; // Typical mobile device FOV.
+
+					_position.frames += 1;
+
+					return new ImageUpdate(image_update);
+				}
+
+				default:
+					//logger()->log(LOG_WARN, LogBuffer() << "Unexpected line: " << parts.at(1).str());
+					break;
+			}
+		}
+
+		return nullptr;
+	}
+
+	Shared<SensorUpdate> SensorStream::next_from_dataset()
+	{
+		if (_position.offset >= _dataset->event_count())
+			return nullptr;
+
+		switch (_dataset->event(_position.offset++)) {
+			case Dataset::Event::MOTION:
+				return new MotionUpdate(_dataset->motion_update(_position.motions++));
+
+			case Dataset::Event::LOCATION:
+				return new LocationUpdate(_dataset->location_update(_position.locations++));
+
+			case Dataset::Event::HEADING:
+				return new HeadingUpdate(_dataset->heading_update(_position.headings++));
+
+			case Dataset::Event::FRAME:
+			{
+				ImageUpdate image_update = _dataset->image_update(_position.frames++);
+				image_update.frame_cache = _frame_cache;
+
+				return new ImageUpdate(image_update);
+			}
+		}
+
+		return nullptr;
+	}
+}
@@ -0,0 +1,75 @@
+//
+//  SensorStream.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_SENSORSTREAM_H
+#define TRANSFORMFLOW_SENSORSTREAM_H
+
+#include "MotionModel.h"
+#include "Dataset.h"
+#include "CSVParser.h"
+
+#include <Dream/Core/Data.h>
+#include <Dream/Resources/Loader.h>
+
+namespace TransformFlow
+{
+	using Resources::ILoader;
+
+	// Reads the sensor updates of a data set one at a time, in order. The log is memory mapped and parsed as updates are requested, so only the update being returned is held in memory, and logs of any length can be processed. Reads the binary data set if there is one, otherwise the CSV log. Frame images are loaded on demand through the frame cache.
+	class SensorStream : public Object
+	{
+	public:
+		// Where an update is in the data set, so that reading can continue from it. For the CSV log, offset is in bytes, for the binary data set it's the event index. The number of updates of each kind before it are also kept, and frames is the sequence number of the next image update, i.e. VideoFrame::index.
+		struct Position
+		{
+			std::uint64_t offset;
+			std::uint64_t motions, locations, headings, frames;
+		};
+
+		SensorStream(Ptr<ILoader> loader, std::size_t frame_budget = 256 * 1024 * 1024);
+		virtual ~SensorStream();
+
+		// The next sensor update, or null at the end of the log.
+		Shared<SensorUpdate> next();
+
+		// The position of the update which next() will return.
+		Position position() const;
+
+		// Continue reading from a position given by position(), normally one stored in a SensorIndex. Throws std::out_of_range if it's outside the data set. Motion rows are accumulated from the position onwards, so it must be the position of a whole update.
+		void seek(const Position & position);
+
+		// The size of the log or binary data set in bytes, which is used to check that an index is up to date.
+		std::size_t size() const;
+
+		Ref<FrameCache> frame_cache() const { return _frame_cache; }
+
+		// The binary data set, or null if the CSV log is being read.
+		Ref<Dataset> dataset() const { return _dataset; }
+
+	protected:
+		Ref<ILoader> _loader;
+		Ref<FrameCache> _frame_cache;
+
+		Position _position;
+
+		// Reading the CSV log:
+		Shared<Buffer> _buffer;
+		CSVParser _parser;
+
+		const char * log_begin() const { return reinterpret_cast<const char *>(_buffer->begin()); }
+
+		// Motion events are accumulated until the Motion row:
+		MotionUpdate _motion_update;
+
+		Shared<SensorUpdate> next_from_log();
+
+		// Reading the binary data set:
+		Ref<Dataset> _dataset;
+
+		Shared<SensorUpdate> next_from_dataset();
+	};
+}
+
+#endif
@@ -0,0 +1,136 @@
+//
+//  ThreadPool.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace TransformFlow
+{
+	ThreadPool::ThreadPool(std::size_t count) : _stopping(false)
+	{
+		if (count == 0)
+			count = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+		for (std::size_t i = 0; i < count; i += 1)
+			_threads.emplace_back(&ThreadPool::run, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_stopping = true;
+		}
+
+		_condition.notify_all();
+
+		for (auto & thread : _threads)
+			thread.join();
+	}
+
+	void ThreadPool::add(TaskT task)
+	{
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_tasks.push_back(std::move(task));
+		}
+
+		_condition.notify_one();
+	}
+
+	void ThreadPool::run()
+	{
+		while (true) {
+			TaskT task;
+
+			{
+				std::unique_lock<std::mutex> guard(_lock);
+
+				_condition.wait(guard, [&]{return _stopping || !_tasks.empty();});
+
+				// Remaining tasks are completed before stopping:
+				if (_tasks.empty())
+					return;
+
+				task = std::move(_tasks.front());
+				_tasks.pop_front();
+			}
+
+			task();
+		}
+	}
+
+	void ThreadPool::parallel_for(std::size_t count, std::function<void(std::size_t)> callback)
+	{
+		if (count == 0) return;
+
+		// The state is shared because helpers may start after all the work has been completed by other threads, and the caller has returned.
+		struct State {
+			std::function<void(std::size_t)> callback;
+
+			std::size_t total;
+			std::atomic<std::size_t> next, completed;
+
+			// Once a call has failed, the remaining indices are skipped rather than calling the callback:
+			std::atomic<bool> failed;
+			std::exception_ptr error;
+
+			std::mutex lock;
+			std::condition_variable condition;
+
+			void work() {
+				std::size_t finished = 0;
+
+				for (std::size_t i = next++; i < total; i = next++) {
+					// Exceptions must not escape, otherwise a worker would terminate the process, and the caller would return while other threads are still using its callback:
+					if (!failed) {
+						try {
+							callback(i);
+						} catch (...) {
+							std::lock_guard<std::mutex> guard(lock);
+
+							if (!error)
+								error = std::current_exception();
+
+							failed = true;
+						}
+					}
+
+					finished += 1;
+				}
+
+				if (finished && (completed += finished) == total) {
+					std::lock_guard<std::mutex> guard(lock);
+					condition.notify_all();
+				}
+			}
+		};
+
+		auto state = std::make_shared<State>();
+		state->callback = std::move(callback);
+		state->next = 0;
+		state->completed = 0;
+		state->failed = false;
+		state->total = count;
+
+		std::size_t helpers = std::min(_threads.size(), count - 1);
+
+		for (std::size_t i = 0; i < helpers; i += 1)
+			add([state]{state->work();});
+
+		// The calling thread also does work, so that nested calls can't deadlock waiting for busy workers:
+		state->work();
+
+		std::unique_lock<std::mutex> guard(state->lock);
+		state->condition.wait(guard, [&]{return state->completed == state->total;});
+
+		if (state->error)
+			std::rethrow_exception(state->error);
+	}
+}
@@ -0,0 +1,52 @@
+//
+//  ThreadPool.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_THREADPOOL_H
+#define TRANSFORMFLOW_THREADPOOL_H
+
+#include <Dream/Class.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+namespace TransformFlow
+{
+	using namespace Dream;
+
+	// A fixed set of worker threads which execute tasks in the order they were added.
+	class ThreadPool : public Object
+	{
+	public:
+		typedef std::function<void()> TaskT;
+
+		// A count of 0 uses one thread per hardware thread.
+		ThreadPool(std::size_t count = 0);
+		virtual ~ThreadPool();
+
+		std::size_t size() const { return _threads.size(); }
+
+		void add(TaskT task);
+
+		// Calls callback(i) for every i in [0, count) using the worker threads and the calling thread, and returns once all calls have completed. It is safe to call this from within a task. If a call throws, no further calls are started, and once the calls in progress on other threads have finished, the first exception is rethrown here.
+		void parallel_for(std::size_t count, std::function<void(std::size_t)> callback);
+
+	protected:
+		std::vector<std::thread> _threads;
+
+		std::mutex _lock;
+		std::condition_variable _condition;
+
+		std::deque<TaskT> _tasks;
+		bool _stopping;
+
+		void run();
+	};
+}
+
+#endif
@@ -7,7 +7,14 @@
 //
 
 #include "VideoStream.h"
+#include "CSVParser.h"
+
 #include <Dream/Core/Data.h>
+#include <Dream/Core/Buffer.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
 
 #include <Euclid/Numerics/Interpolate.h>
 #include <Euclid/Numerics/Transforms.h>
@@ -16,17 +23,53 @@
 namespace TransformFlow {
 	using namespace Dream::Events::Logging;
 	
-	const char * GYROSCOPE = "Gyroscope";
-	const char * ACCELEROMETER = "Accelerometer";
-	const char * GRAVITY = "Gravity";
-	const char * MOTION = "Motion";
-	const char * LOCATION = "Location";
-	const char * HEADING = "Heading";
-	const char * FRAME = "Frame";
+	SensorData::SensorData(Ptr<ILoader> loader, std::size_t frame_budget) : _loader(loader)
+	{
+		Ref<SensorStream> sensor_stream = new SensorStream(loader, frame_budget);
+
+		_frame_cache = sensor_stream->frame_cache();
+		_dataset = sensor_stream->dataset();
+
+		if (_dataset) {
+			_sensor_stream = sensor_stream;
+		} else {
+			// The log has to be parsed to find the updates, so the index is built at the same time:
+			_index = new SensorIndex(*sensor_stream, [&](Shared<SensorUpdate> sensor_update) {
+				_sensor_updates.push_back(sensor_update);
+			});
+		}
+	}
 
-	SensorData::SensorData(Ptr<ILoader> loader) : _loader(loader)
+	const std::vector<Shared<SensorUpdate>> & SensorData::sensor_updates() const
 	{
-		parse_log();
+		if (_dataset) {
+			// If reading fails, e.g. because the data set is corrupted, the next call starts again from the beginning and fails the same way:
+			std::call_once(_sensor_updates_read, [&]() {
+				std::vector<Shared<SensorUpdate>> sensor_updates;
+				sensor_updates.reserve(_dataset->event_count());
+
+				_sensor_stream->seek(SensorStream::Position());
+
+				while (Shared<SensorUpdate> sensor_update = _sensor_stream->next())
+					sensor_updates.push_back(sensor_update);
+
+				_sensor_updates.swap(sensor_updates);
+				_sensor_stream = nullptr;
+			});
+		}
+
+		return _sensor_updates;
+	}
+
+	Ref<SensorIndex> SensorData::index() const
+	{
+		if (_dataset) {
+			std::call_once(_index_built, [&]() {
+				_index = new SensorIndex(*_dataset);
+			});
+		}
+
+		return _index;
 	}
 
 	SensorData::~SensorData() noexcept
@@ -34,117 +77,51 @@ namespace TransformFlow {
 		
 	}
 	
-	Ref<Image> SensorData::frame_for_index(std::size_t index) {
-		if (index < _frames.size()) {
-			if (_frames[index]) {
-				return _frames[index];
-			}
-		} else {
-			_frames.resize(index+1);
-		}
-				
-		return (_frames[index] = _loader->load<Image>(to_string(index)));
-	}
-	
-	void SensorData::parse_log()
+	// Memory map the data and parse each row in place:
+	static void parse_rows(Ptr<IData> data, std::function<void(const CSVParser::RowT &)> row_callback)
 	{
-		Ref<IData> data = _loader->data_for_resource("log");
-		Shared<std::istream> stream = data->input_stream();
-		
-		std::string line;
+		Shared<Buffer> buffer = data->buffer();
 
-		MotionUpdate motion_update;
+		const char * begin = reinterpret_cast<const char *>(buffer->begin());
+		CSVParser parser(begin, begin + buffer->size());
 
-		while (stream->good())
-		{
-			std::getline(*stream, line, '\n');
-			
-			std::vector<std::string> parts;
-			split(line, ',', std::back_inserter(parts));
-			
-			for (auto & part : parts)
-				part = trimmed(part, " ");
-			
-			if (parts.size() < 2)
-				continue;
+		while (parser.next_row())
+			row_callback(parser.row());
+	}
 
-			if (parts.at(1) == GYROSCOPE)
-			{
-				motion_update.rotation_rate = Vec3(to<RealT>(parts.at(3)), to<RealT>(parts.at(4)), to<RealT>(parts.at(5)));
-			}
-			else if (parts.at(1) == ACCELEROMETER)
-			{
-				motion_update.acceleration = Vec3(to<RealT>(parts.at(3)), to<RealT>(parts.at(4)), to<RealT>(parts.at(5)));
-			}
-			else if (parts.at(1) == GRAVITY)
-			{
-				motion_update.gravity = Vec3(to<RealT>(parts.at(3)), to<RealT>(parts.at(4)), to<RealT>(parts.at(5)));
-			}
-			else if (parts.at(1) == MOTION)
-			{
-				motion_update.time_offset = to<TimeT>(parts.at(2));
+	void VideoStream::VideoFrame::capture(const MotionModel & motion_model)
+	{
+		valid = motion_model.localization_valid();
 
-				_sensor_updates.push_back(new MotionUpdate(motion_update));
-			}
-			else if (parts.at(1) == LOCATION)
-			{
-				LocationUpdate location_update;
-
-				location_update.time_offset = to<TimeT>(parts.at(2));
-				location_update.latitude = to<double>(parts.at(3));
-				location_update.longitude = to<double>(parts.at(4));
-				location_update.altitude = to<double>(parts.at(5));
-				
-				location_update.horizontal_accuracy = to<double>(parts.at(6));
-				location_update.vertical_accuracy = to<double>(parts.at(7));
-
-				_sensor_updates.push_back(new LocationUpdate(location_update));
-			}
-			else if (parts.at(1) == HEADING)
-			{
-				HeadingUpdate heading_update;
-				
-				heading_update.time_offset = to<TimeT>(parts.at(2));
-				heading_update.magnetic_bearing = to<double>(parts.at(3));
-				heading_update.true_bearing = to<double>(parts.at(4));
-
-				_sensor_updates.push_back(new HeadingUpdate(heading_update));
-			}
-			else if (parts.at(1) == FRAME)
-			{
-				ImageUpdate image_update;
-				
-				image_update.time_offset = to<RealT>(parts.at(2));
-				image_update.image_buffer = frame_for_index(to<std::size_t>(parts.at(3)));
-
-				// http://www.boinx.com/chronicles/2013/3/22/field-of-view-fov-of-cameras-in-ios-devices/
-				if (parts.size() >= 5)
-					image_update.field_of_view = radians(to<RealT>(parts.at(4)));
-				else
-					image_update.field_of_view = 55.0_deg; // Typical mobile device FOV.
-
-				_sensor_updates.push_back(new ImageUpdate(image_update));
-			}
-			else
-			{
-				//logger()->log(LOG_WARN, LogBuffer() << "Unexpected line: " << line);
-			}
+		if (valid) {
+			gravity = motion_model.gravity().normalize();
+			bearing = motion_model.bearing();
+			tilt = motion_model.tilt();
+
+			// Global coordinate system:
+			Vec3 down(0, -1, 0), north(0, 0, -1);
+		
+			heading = (Quat(rotate(bearing, down)) * north).normalize();
 		}
 	}
 
-	void VideoStream::VideoFrame::calculate_feature_points()
+	void VideoStream::VideoFrame::calculate_feature_points(Ref<ThreadPool> thread_pool)
 	{
 		Dream::Core::Stopwatch watch;
 		watch.start();
 
 		feature_points = new FeaturePoints;
-		feature_points->scan(image_update->image_buffer, tilt);
+		feature_points->set_thread_pool(thread_pool);
+		feature_points->scan(*image_update, tilt);
 
 		watch.pause();
 	}
 
-	VideoStream::VideoStream(Ptr<ILoader> loader, Ref<MotionModel> motion_model) : _loader(loader), _motion_model(motion_model)
+	VideoStream::VideoStream(Ptr<ILoader> loader, Ref<MotionModel> motion_model, Ref<ThreadPool> thread_pool, std::size_t prefetch_depth, std::size_t checkpoint_interval, ProgressCallbackT progress) : _loader(loader), _motion_model(motion_model), _thread_pool(thread_pool), _prefetch_depth(prefetch_depth), _checkpoint_interval(checkpoint_interval), _progress(progress)
 	{
+		if (!_thread_pool)
+			_thread_pool = new ThreadPool;
+
 		load_frames();
 		load_tracking_points();
 	}
@@ -152,56 +129,166 @@ namespace TransformFlow {
 	void VideoStream::load_frames()
 	{
 		_sensor_data = new SensorData(_loader);
-		
+
+		auto & sensor_updates = _sensor_data->sensor_updates();
+		std::size_t index = 0;
+
+		auto next_update = [&]() -> Shared<SensorUpdate> {
+			if (index < sensor_updates.size())
+				return sensor_updates[index++];
+			else
+				return nullptr;
+		};
+
+		std::size_t frame_count = _sensor_data->index()->frame_count();
+		_frames.reserve(frame_count);
+
+		// The motion model has to see every update in order, so this is sequential, but it's fast without scanning the feature points. If the model doesn't use the images, they aren't loaded until their feature points are scanned, so each one is only decoded once:
+		std::size_t prefetch_depth = _motion_model->uses_images() ? _prefetch_depth : 0;
+
+		replay(next_update, *_motion_model, _thread_pool, prefetch_depth, [&](const VideoFrame & video_frame) {
+			_frames.push_back(video_frame);
+
+			if (_progress)
+				_progress(LoadPhase::FUSION, _frames.size(), frame_count);
+		}, 0, _checkpoint_interval, [&](const Checkpoint & checkpoint) {
+			_checkpoints.push_back(checkpoint);
+		});
+
+		load_feature_points(_thread_pool);
+	}
+
+	void VideoStream::load_feature_points(Ref<ThreadPool> thread_pool)
+	{
+		std::vector<std::size_t> valid_frames;
+
+		for (std::size_t i = 0; i < _frames.size(); i += 1) {
+			if (_frames[i].valid)
+				valid_frames.push_back(i);
+		}
+
+		std::mutex progress_lock;
+		std::size_t completed = 0;
+
+		// Each frame is scanned on a single thread, as there are enough frames to keep all the threads busy. The most recent frames are scanned first, as their images are the most likely to still be in the frame cache. If loading an image fails, the error is rethrown once the other frames in progress have finished:
+		thread_pool->parallel_for(valid_frames.size(), [&](std::size_t i) {
+			_frames[valid_frames[valid_frames.size() - 1 - i]].calculate_feature_points();
+
+			if (_progress) {
+				std::lock_guard<std::mutex> guard(progress_lock);
+
+				completed += 1;
+				_progress(LoadPhase::FEATURES, completed, valid_frames.size());
+			}
+		});
+	}
+
+	const VideoStream::Checkpoint * VideoStream::checkpoint_for_frame(std::size_t frame) const
+	{
+		auto checkpoint = std::upper_bound(_checkpoints.begin(), _checkpoints.end(), frame, [](std::size_t frame, const Checkpoint & checkpoint) {
+			return frame < checkpoint.frame;
+		});
+
+		if (checkpoint == _checkpoints.begin())
+			return nullptr;
+
+		return &*(checkpoint - 1);
+	}
+
+	void VideoStream::stream(Ptr<ILoader> loader, Ref<MotionModel> motion_model, FrameCallbackT callback, Ref<ThreadPool> thread_pool, std::size_t prefetch_depth)
+	{
+		stream(loader, SensorStream::Position(), motion_model, callback, thread_pool, prefetch_depth);
+	}
+
+	void VideoStream::stream(Ptr<ILoader> loader, const SensorStream::Position & from, Ref<MotionModel> motion_model, FrameCallbackT callback, Ref<ThreadPool> thread_pool, std::size_t prefetch_depth)
+	{
+		Ref<SensorStream> sensor_stream = new SensorStream(loader);
+		sensor_stream->seek(from);
+
+		// Frames are passed on as they are completed, so the feature points are scanned one frame at a time:
+		replay([&]{return sensor_stream->next();}, *motion_model, thread_pool, prefetch_depth, [&](const VideoFrame & video_frame) {
+			if (video_frame.valid) {
+				VideoFrame scanned_frame = video_frame;
+				scanned_frame.calculate_feature_points(thread_pool);
+
+				callback(scanned_frame);
+			} else {
+				callback(video_frame);
+			}
+		}, from.frames);
+	}
+
+	void VideoStream::resume(Ptr<ILoader> loader, Ref<SensorIndex> index, const Checkpoint & checkpoint, Ref<MotionModel> motion_model, FrameCallbackT callback, Ref<ThreadPool> thread_pool, std::size_t prefetch_depth)
+	{
+		motion_model->restore(*checkpoint.snapshot);
+
+		stream(loader, index->position_for_frame(checkpoint.frame), motion_model, callback, thread_pool, prefetch_depth);
+	}
+
+	void VideoStream::replay(std::function<Shared<SensorUpdate>()> next_update, MotionModel & motion_model, Ref<ThreadPool> thread_pool, std::size_t prefetch_depth, FrameCallbackT callback, std::size_t first_frame, std::size_t checkpoint_interval, CheckpointCallbackT checkpoint_callback)
+	{
+		// Images are decoded ahead of time, so that replay isn't held up by loading them:
+		FramePrefetcher prefetcher(thread_pool, prefetch_depth);
+
+		// Updates are read ahead until there are enough images to prefetch, so only the updates between the current one and the last prefetched image are buffered. If there are no images for a while, the front update is processed once MAXIMUM_LOOKAHEAD updates have been read:
+		std::deque<Shared<SensorUpdate>> lookahead;
+		std::size_t lookahead_images = 0;
+		bool finished = false;
+
 		// This frame index is relating to the actual index of the frame data.
-		std::size_t frame_index = 0;
+		std::size_t frame_index = first_frame;
 		
-		for (auto & update : _sensor_data->sensor_updates()) {
-			// We process all updates in order, to calculate the information at specific video frames:
-			_motion_model->update(update.get());
+		while (true) {
+			while (!finished && (lookahead.empty() || (lookahead_images < prefetch_depth && lookahead.size() < MAXIMUM_LOOKAHEAD))) {
+				Shared<SensorUpdate> update = next_update();
 
-			if (Shared<ImageUpdate> image_update = update) {
-				VideoFrame video_frame;
+				if (!update) {
+					finished = true;
+				} else {
+					Shared<ImageUpdate> image_update = update;
 
-				video_frame.index = frame_index;
-				video_frame.image_update = image_update;
-				video_frame.valid = _motion_model->localization_valid();
+					if (image_update && prefetch_depth) {
+						prefetcher.push(image_update);
+						lookahead_images += 1;
+					}
+
+					lookahead.push_back(update);
+				}
+			}
+
+			if (lookahead.empty()) break;
 
-				if (video_frame.valid) {
-					video_frame.gravity = _motion_model->gravity().normalize();
-					video_frame.bearing = _motion_model->bearing();
-					video_frame.tilt = _motion_model->tilt();
+			Shared<SensorUpdate> update = lookahead.front();
+			lookahead.pop_front();
 
-					// Global coordinate system:
-					Vec3 down(0, -1, 0), north(0, 0, -1);
-				
-					Vec3 heading = Quat(rotate(video_frame.bearing, down)) * north;
-					video_frame.heading = heading.normalize();
+			Shared<ImageUpdate> image_update = update;
 
-					video_frame.calculate_feature_points();
+			// The prefetched image is still in the frame cache when the motion model uses it, and this keeps it alive until the frame has been processed:
+			Ref<Image> image;
+
+			if (image_update) {
+				if (prefetch_depth) {
+					image = prefetcher.next();
+					lookahead_images -= 1;
 				}
 
-				_frames.push_back(video_frame);
-				frame_index += 1;
+				if (checkpoint_interval && frame_index % checkpoint_interval == 0)
+					checkpoint_callback({frame_index, motion_model.snapshot()});
 			}
-		}
-	}
-	
-	static void parse_rows(std::istream & input, std::function<void(const std::vector<std::string> &)> row_callback)
-	{
-		std::string line;
 
-		while (input.good())
-		{
-			std::getline(input, line, '\n');
-			
-			std::vector<std::string> parts;
-			split(line, ',', std::back_inserter(parts));
-			
-			for (auto & part : parts)
-				part = trimmed(part, " ");
-			
-			row_callback(parts);
+			// We process all updates in order, to calculate the information at specific video frames:
+			motion_model.update(update.get());
+
+			if (image_update) {
+				VideoFrame video_frame;
+
+				video_frame.index = frame_index;
+				video_frame.image_update = image_update;
+				video_frame.capture(motion_model);
+
+				callback(video_frame);
+				frame_index += 1;
+			}
 		}
 	}
 	
@@ -215,22 +302,20 @@ namespace TransformFlow {
 			return;
 		}
 		
-		Shared<std::istream> stream = data->input_stream();
-		
 		//image_frame,tracking_index,x,y[,z]
-		parse_rows(*stream, [&](const std::vector<std::string> & parts) {
+		parse_rows(data, [&](const CSVParser::RowT & parts) {
 			if (parts.size() < 4) return;
 			
 			TrackingPoint tracking_point;
 			
-			tracking_point.frame_index = to<std::size_t>(parts.at(0));
-			tracking_point.tracking_index = to<std::size_t>(parts.at(1));
+			tracking_point.frame_index = parts.at(0).to<std::size_t>();
+			tracking_point.tracking_index = parts.at(1).to<std::size_t>();
 			
-			tracking_point.coordinate[X] = to<RealT>(parts.at(2));
-			tracking_point.coordinate[Y] = to<RealT>(parts.at(3));
+			tracking_point.coordinate[X] = parts.at(2).to<RealT>();
+			tracking_point.coordinate[Y] = parts.at(3).to<RealT>();
 			
 			if (parts.size() >= 5)
-				tracking_point.coordinate[Z] = to<RealT>(parts.at(4));
+				tracking_point.coordinate[Z] = parts.at(4).to<RealT>();
 			else
 				tracking_point.coordinate[Z] = 0;
 			
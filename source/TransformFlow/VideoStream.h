@@ -11,9 +11,15 @@
 
 #include "MotionModel.h"
 #include "FeaturePoints.h"
+#include "SensorStream.h"
+#include "SensorIndex.h"
+#include "FramePrefetcher.h"
 
+#include <Dream/Core/Data.h>
 #include <Dream/Resources/Loader.h>
 
+#include <mutex>
+
 namespace TransformFlow
 {
 	using Resources::ILoader;
@@ -23,18 +29,36 @@ namespace TransformFlow
 		protected:
 			Ref<ILoader> _loader;
 			
-			std::vector<Ref<Image>> _frames;
-			Ref<Image> frame_for_index(std::size_t index);
+			// Image updates refer to this, and load their images on demand:
+			Ref<FrameCache> _frame_cache;
+
+			// A binary data set is read through this the first time the updates are used, and it's released afterwards:
+			mutable Ref<SensorStream> _sensor_stream;
+			Ref<Dataset> _dataset;
 
-			std::vector<Shared<SensorUpdate>> _sensor_updates;
+			mutable std::once_flag _sensor_updates_read, _index_built;
+			mutable std::vector<Shared<SensorUpdate>> _sensor_updates;
 
-			void parse_log();
+			// Entry i is sensor_updates()[i]:
+			mutable Ref<SensorIndex> _index;
 
 		public:
-			SensorData(Ptr<ILoader> loader);
+			// Reads all the updates of a data set, see SensorStream. The CSV log is parsed immediately. The binary data set is only opened, and its updates and index are read the first time they are used, so this takes constant time. Frame images are not loaded until they are used, and at most frame_budget bytes of decoded images are cached.
+			SensorData(Ptr<ILoader> loader, std::size_t frame_budget = 256 * 1024 * 1024);
 			virtual ~SensorData() noexcept;
 
-			const std::vector<Shared<SensorUpdate>> & sensor_updates() const { return _sensor_updates; }
+			Ref<FrameCache> frame_cache() const { return _frame_cache; }
+
+			const std::vector<Shared<SensorUpdate>> & sensor_updates() const;
+
+			// This can be written as a sidecar, so that the data set can be streamed from any point without loading it. For a binary data set, it's built from the event column without reading the updates.
+			Ref<SensorIndex> index() const;
+
+			// The first update at or after the given time, or sensor_updates().size() if there isn't one.
+			std::size_t update_for_time(TimeT time_offset) const { return index()->entry_for_time(time_offset); }
+
+			// The image update of the given frame. Throws std::out_of_range if there is no such frame.
+			std::size_t update_for_frame(std::size_t frame) const { return index()->entry_for_frame(frame); }
 	};
 	
 	class VideoStream : public Object
@@ -67,28 +91,86 @@ namespace TransformFlow
 
 				Ref<FeaturePoints> feature_points;
 
-				void calculate_feature_points();
+				// Record whether the localization is valid, and if so, the orientation given by the motion model.
+				void capture(const MotionModel & motion_model);
+
+				void calculate_feature_points(Ref<ThreadPool> thread_pool = nullptr);
 				
 				std::unordered_map<std::size_t, TrackingPoint> tracking_points;
 			};
 
+			typedef std::function<void(const VideoFrame &)> FrameCallbackT;
+
+			// The state of the motion model just before the image update of a frame, so that replay can be resumed from that frame.
+			struct Checkpoint
+			{
+				std::size_t frame;
+				Ref<MotionModel::Snapshot> snapshot;
+			};
+
+			typedef std::function<void(const Checkpoint &)> CheckpointCallbackT;
+
+			// Loading frames is done in two phases: the motion model is run over every update, then the feature points of the valid frames are scanned in parallel.
+			enum class LoadPhase {
+				FUSION,
+				FEATURES
+			};
+
+			// Called as each frame is completed in each phase. Calls are never concurrent, but in the features phase they come from the worker threads.
+			typedef std::function<void(LoadPhase phase, std::size_t completed, std::size_t total)> ProgressCallbackT;
+
 		protected:
 			Ref<ILoader> _loader;
 			
 			Ref<SensorData> _sensor_data;
 			Ref<MotionModel> _motion_model;
+			Ref<ThreadPool> _thread_pool;
+			std::size_t _prefetch_depth;
+			std::size_t _checkpoint_interval;
+			ProgressCallbackT _progress;
 
 			std::vector<VideoFrame> _frames;
+			std::vector<Checkpoint> _checkpoints;
 			std::vector<TrackingPoint> _tracking_points;
 
 			void load_frames();
+
+			// Scan the feature points of every valid frame, which only depends on the image and the tilt of the frame, so the frames are processed in parallel.
+			void load_feature_points(Ref<ThreadPool> thread_pool);
 			void load_tracking_points();
 
+			// Apply the updates to the motion model in order, and pass each frame to the callback once it has been processed. Feature points are not calculated. Images are prefetched up to prefetch_depth frames ahead; if it is 0, they aren't loaded here at all, so a model which uses them loads them itself. Frames are numbered from first_frame. If checkpoint_interval is non-zero, a checkpoint is taken before every frame whose index is a multiple of it.
+			static void replay(std::function<Shared<SensorUpdate>()> next_update, MotionModel & motion_model, Ref<ThreadPool> thread_pool, std::size_t prefetch_depth, FrameCallbackT callback, std::size_t first_frame = 0, std::size_t checkpoint_interval = 0, CheckpointCallbackT checkpoint_callback = nullptr);
+
 		public:
-			VideoStream(Ptr<ILoader> loader, Ref<MotionModel> motion_model);
+			// If a thread pool is provided, it is used for scanning feature points and loading images, otherwise one is created. Up to prefetch_depth images are loaded ahead of the motion model if it uses them, see FramePrefetcher and MotionModel::uses_images(). If checkpoint_interval is non-zero, the state of the motion model is saved every checkpoint_interval frames. The progress callback, if given, is called as frames are loaded.
+			VideoStream(Ptr<ILoader> loader, Ref<MotionModel> motion_model, Ref<ThreadPool> thread_pool = nullptr, std::size_t prefetch_depth = 8, std::size_t checkpoint_interval = 0, ProgressCallbackT progress = nullptr);
 			virtual ~VideoStream() noexcept;
 
 			const std::vector<VideoFrame> & frames() const { return _frames; }
+
+			const std::vector<Checkpoint> & checkpoints() const { return _checkpoints; }
+
+			// The last checkpoint at or before the given frame, or null if there isn't one.
+			const Checkpoint * checkpoint_for_frame(std::size_t frame) const;
+
+			// The sensor data which was replayed, and its index.
+			Ref<SensorData> sensor_data() const { return _sensor_data; }
+
+			// The first frame at or after the given time, or frames().size() if there isn't one.
+			std::size_t frame_for_time(TimeT time_offset) const { return _sensor_data->index()->position_for_time(time_offset).frames; }
+
+			// While looking for images to prefetch, at most this many updates are read ahead of the motion model, so that a log with a long stretch without frames isn't buffered in full.
+			static const std::size_t MAXIMUM_LOOKAHEAD = 4096;
+
+			// Process a data set without keeping it in memory. Sensor updates are read one at a time, and each frame is passed to the callback once it has been processed, after which it can be discarded, e.g. once the results have been written to disk. Only the updates up to the last prefetched image, and at most MAXIMUM_LOOKAHEAD of them, are buffered. Tracking points are not loaded.
+			static void stream(Ptr<ILoader> loader, Ref<MotionModel> motion_model, FrameCallbackT callback, Ref<ThreadPool> thread_pool = nullptr, std::size_t prefetch_depth = 8);
+
+			// Stream a data set from a position given by a SensorIndex, e.g. index->position_for_time(time_offset), without reading the updates before it. Frames are numbered from the start of the data set. The motion model only sees the updates from the position onwards, so it needs to be restored to its state at that point, otherwise it has to converge again.
+			static void stream(Ptr<ILoader> loader, const SensorStream::Position & from, Ref<MotionModel> motion_model, FrameCallbackT callback, Ref<ThreadPool> thread_pool = nullptr, std::size_t prefetch_depth = 8);
+
+			// Restore the motion model from the checkpoint, and stream the data set from the checkpoint's frame. The motion model must be constructed the same way as the one which was checkpointed, and the result is the same as replaying the data set from the start.
+			static void resume(Ptr<ILoader> loader, Ref<SensorIndex> index, const Checkpoint & checkpoint, Ref<MotionModel> motion_model, FrameCallbackT callback, Ref<ThreadPool> thread_pool = nullptr, std::size_t prefetch_depth = 8);
 			
 			const std::vector<TrackingPoint> & tracking_points() const { return _tracking_points; }
 	};
@@ -0,0 +1,168 @@
+//
+//  VisionCorrection.cpp
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#include "VisionCorrection.h"
+
+namespace TransformFlow
+{
+	RealT VisionCorrection::History::calculate_estimate(const ImageUpdate & image_update, Radians<> current_relative_rotation) const
+	{
+		auto dr = current_relative_rotation - relative_rotation;
+		return image_update.pixels_of(dr);
+	}
+
+	Average<RealT> VisionCorrection::History::calculate_offset(Ptr<FeaturePoints> current_feature_points, const RealT & estimate) const
+	{
+		auto current_table = current_feature_points->table();
+		auto previous_table = feature_points->table();
+
+		return previous_table->calculate_offset(*current_table, -estimate);
+	}
+
+	RealT VisionCorrection::History::calculate_bearing(const ImageUpdate & image_update, const Average<RealT> & offset) const
+	{
+		// The offset is measured in pixels, so we convert it to degrees and use it to rectify errors in the gyro/compass:
+		RealT image_bearing_offset = R2D * image_update.angle_of(offset.value());
+
+		return corrected_bearing + image_bearing_offset;
+	}
+
+	bool VisionCorrection::History::compatible(Ptr<FeaturePoints> current_feature_points) const
+	{
+		auto current_table = current_feature_points->table();
+		auto previous_table = feature_points->table();
+
+		return current_table->dy() == previous_table->dy() && current_table->pixels_per_bin() == previous_table->pixels_per_bin();
+	}
+
+	VisionCorrection::VisionCorrection(std::size_t dy, Ref<ThreadPool> thread_pool) : _dy(dy), _thread_pool(thread_pool), _history_shared(false), _corrected_bearing(0), _previous_bearing(0)
+	{
+	}
+
+	Ref<FeaturePoints> VisionCorrection::acquire()
+	{
+		// The pool keeps the memory from previous frames, so a serial scan doesn't need to allocate, although the notes added to the image update do:
+		Ref<FeaturePoints> feature_points = _feature_points_pool.acquire();
+		feature_points->set_thread_pool(_thread_pool);
+
+		return feature_points;
+	}
+
+	void VisionCorrection::release(Ref<FeaturePoints> feature_points)
+	{
+		_feature_points_pool.release(feature_points);
+	}
+
+	void VisionCorrection::update(const ImageUpdate & image_update, const Vec3 & gravity, Radians<> relative_rotation, RealT bearing)
+	{
+		Ref<FeaturePoints> feature_points = acquire();
+		feature_points->scan(image_update, device_tilt(gravity), _dy);
+
+		apply(feature_points, relative_rotation, bearing, image_update, relative_rotation);
+	}
+
+	void VisionCorrection::apply(Ref<FeaturePoints> feature_points, Radians<> relative_rotation, RealT bearing, const ImageUpdate & image_update, Radians<> current_relative_rotation)
+	{
+		StringStreamT note;
+
+		// The bearing at the time of the frame:
+		RealT corrected_bearing;
+
+		if (!feature_points->scanned())
+		{
+			// There was no image for this frame, e.g. it was missing from the data set, so only the sensors can be used. The reference is kept for the next frame:
+			corrected_bearing = bearing;
+
+			note << "No image for this frame. Sensor update." << std::endl;
+
+			_feature_points_pool.release(feature_points);
+
+			image_update.add_note(note.str());
+		}
+		else if (_history.feature_points && !_history.compatible(feature_points))
+		{
+			// The scheduler changed the quality, so this frame can't be aligned with the reference. It becomes the new reference, keeping the correction accumulated so far, along with the rotation measured by the gyroscope since the reference:
+			corrected_bearing = _history.corrected_bearing + R2D * (relative_rotation - _history.relative_rotation);
+
+			note << "Scan quality changed (dy = " << feature_points->table()->dy() << ", pixels per bin = " << feature_points->table()->pixels_per_bin() << "). Updating tracking reference..." << std::endl;
+
+			release_history();
+			_history = History{feature_points, relative_rotation, corrected_bearing};
+
+			image_update.add_note(note.str());
+		}
+		else if (_history.feature_points)
+		{
+			auto estimate = _history.calculate_estimate(image_update, relative_rotation);
+			auto offset = _history.calculate_offset(feature_points, estimate);
+
+			// At least 3 vertical edges contributed to this sample:
+
+			if (offset.number_of_samples() >= 3) {
+				RealT image_bearing = _history.calculate_bearing(image_update, offset);
+
+				note << "Hybrid update (confidence = " << offset.number_of_samples() << "). Hybrid: " << (image_bearing - _history.corrected_bearing) << " Sensors: " << (bearing - _previous_bearing) << std::endl;
+
+				corrected_bearing = interpolateAnglesDegrees(bearing, image_bearing, 0.995);
+			} else {
+				corrected_bearing = bearing;
+
+				note << "Sensor update (confidence = " << offset.number_of_samples() << "). Gyroscope: " << (bearing - _previous_bearing) << std::endl;
+			}
+
+			note << "Pixel estimate " << estimate << std::endl;
+
+			// Only update history if there is a signifcant change, otherwise keep tracking local frame of reference.
+			if (estimate < -1.0 || estimate > 1.0) {
+				note << "Updating tracking reference..." << std::endl;
+
+				release_history();
+				_history = History{feature_points, relative_rotation, corrected_bearing};
+			} else {
+				_feature_points_pool.release(feature_points);
+			}
+
+			image_update.add_note(note.str());
+		} else {
+			corrected_bearing = bearing;
+
+			_history = History{feature_points, relative_rotation, corrected_bearing};
+		}
+
+		// If the frame was scanned asynchronously, the device may have rotated since, which the gyroscope has measured:
+		RealT rotation_since_frame = R2D * (current_relative_rotation - relative_rotation);
+
+		_corrected_bearing = corrected_bearing + rotation_since_frame;
+
+		// Used to compute a hybrid update between purely sensor based update, or sensor+image based update:
+		_previous_bearing = bearing;
+	}
+
+	void VisionCorrection::release_history()
+	{
+		if (_history.feature_points && !_history_shared)
+			_feature_points_pool.release(_history.feature_points);
+
+		_history_shared = false;
+	}
+
+	VisionCorrection::State VisionCorrection::state()
+	{
+		_history_shared = true;
+
+		return State{_history, _corrected_bearing, _previous_bearing};
+	}
+
+	void VisionCorrection::restore(const State & state)
+	{
+		release_history();
+
+		_history = state.history;
+		_history_shared = true;
+
+		_corrected_bearing = state.corrected_bearing;
+		_previous_bearing = state.previous_bearing;
+	}
+}
@@ -0,0 +1,84 @@
+//
+//  VisionCorrection.h
+//  This file is part of the "Transform Flow" project and released under the MIT License.
+//
+
+#ifndef TRANSFORMFLOW_VISIONCORRECTION_H
+#define TRANSFORMFLOW_VISIONCORRECTION_H
+
+#include "SensorFusion.h"
+#include "FeaturePoints.h"
+
+namespace TransformFlow
+{
+	// Corrects the bearing from sensor fusion by aligning the feature points of each image with a reference image, as used by HybridMotionModel. Nothing here is virtual, so that it can be composed with SensorFusion at compile time, see ComposedMotionModel.
+	class VisionCorrection
+	{
+	public:
+		struct History
+		{
+			Ref<FeaturePoints> feature_points;
+			Radians<> relative_rotation;
+			RealT corrected_bearing;
+
+			RealT calculate_estimate(const ImageUpdate & image_update, Radians<> current_relative_bearing) const;
+			Average<RealT> calculate_offset(Ptr<FeaturePoints> current_feature_points, const RealT & estimate) const;
+			RealT calculate_bearing(const ImageUpdate & image_update, const Average<RealT> & offset) const;
+
+			// Whether the current feature points were scanned with the same spacing, so that they can be aligned:
+			bool compatible(Ptr<FeaturePoints> current_feature_points) const;
+		};
+
+		struct State
+		{
+			History history;
+
+			RealT corrected_bearing, previous_bearing;
+		};
+
+		VisionCorrection(std::size_t dy = 15, Ref<ThreadPool> thread_pool = nullptr);
+
+		// Feature points for scanning an image, which should be given to apply() or release() once scanned.
+		Ref<FeaturePoints> acquire();
+		void release(Ref<FeaturePoints> feature_points);
+
+		// Update the bearing using the feature points of an image, along with the relative rotation and bearing from sensor fusion when the image arrived. If the image was scanned some time ago, the current relative rotation accounts for any rotation since. Notes are added to the given image update.
+		void apply(Ref<FeaturePoints> feature_points, Radians<> relative_rotation, RealT bearing, const ImageUpdate & image_update, Radians<> current_relative_rotation);
+
+		// Scan the image, aligned with the given gravity vector, and apply it straight away.
+		void update(const ImageUpdate & image_update, const Vec3 & gravity, Radians<> relative_rotation, RealT bearing);
+
+		bool uses_images() const { return true; }
+
+		// Whether there is a reference image, otherwise the corrected bearing is meaningless.
+		bool primed() const { return bool(_history.feature_points); }
+
+		// Measured in degrees from north.
+		RealT corrected_bearing() const { return _corrected_bearing; }
+
+		// The feature points in the state are shared with this correction until it moves on to a new reference image.
+		State state();
+		void restore(const State & state);
+
+	protected:
+		const std::size_t _dy;
+
+		// Used for scanning images in parallel, if provided:
+		Ref<ThreadPool> _thread_pool;
+
+		History _history;
+
+		// The pool reuses feature points once they are released, so feature points which are shared with a snapshot must not be released:
+		bool _history_shared;
+		void release_history();
+
+		FeaturePointsPool _feature_points_pool;
+
+		RealT _corrected_bearing;
+
+		// Measured in degrees from north:
+		RealT _previous_bearing;
+	};
+}
+
+#endif
@@ -0,0 +1,72 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/BasicSensorMotionModel.h>
+#include <Dream/Core/Timer.h>
+
+#include <cmath>
+
+namespace TransformFlow {
+	UnitTest::Suite BasicSensorMotionModelTestSuite {
+		"Test Basic Sensor Motion Model Functionality",
+
+		{"Check Batched Motion Updates",
+			[](UnitTest::Examiner & examiner) {
+				// 100Hz gyro samples, with a compass update every second:
+				const std::size_t RUNS = 2000, RUN_LENGTH = 100;
+
+				std::vector<MotionUpdate> motion_updates(RUNS * RUN_LENGTH);
+				std::vector<HeadingUpdate> heading_updates(RUNS);
+
+				for (std::size_t i = 0; i < motion_updates.size(); i += 1) {
+					MotionUpdate & motion_update = motion_updates[i];
+
+					motion_update.time_offset = i * 0.01;
+					motion_update.gravity = {0.1f * std::sin(i * 0.001f), -1, 0.1f * std::cos(i * 0.003f)};
+					motion_update.rotation_rate = {0.05f, 0.5f * std::sin(i * 0.02f), 0};
+				}
+
+				for (std::size_t run = 0; run < RUNS; run += 1) {
+					HeadingUpdate & heading_update = heading_updates[run];
+
+					heading_update.time_offset = run * RUN_LENGTH * 0.01;
+					heading_update.magnetic_bearing = heading_update.true_bearing = 170 + (run % 7) * 3;
+				}
+
+				Ref<BasicSensorMotionModel> sequential = new BasicSensorMotionModel;
+				Ref<BasicSensorMotionModel> batched = new BasicSensorMotionModel;
+
+				RealT largest_difference = 0;
+
+				Dream::Core::Stopwatch sequential_watch, batched_watch;
+
+				for (std::size_t run = 0; run < RUNS; run += 1) {
+					const MotionUpdate * run_updates = motion_updates.data() + run * RUN_LENGTH;
+
+					sequential->update(heading_updates[run]);
+					batched->update(heading_updates[run]);
+
+					sequential_watch.start();
+					for (std::size_t i = 0; i < RUN_LENGTH; i += 1)
+						sequential->update(run_updates[i]);
+					sequential_watch.pause();
+
+					batched_watch.start();
+					batched->update(run_updates, RUN_LENGTH);
+					batched_watch.pause();
+
+					// The bearing wraps around at +/-180 degrees:
+					RealT difference = std::abs(std::remainder(R2D * batched->bearing() - R2D * sequential->bearing(), RealT(360)));
+
+					if (difference > largest_difference)
+						largest_difference = difference;
+				}
+
+				examiner.check(largest_difference <= SensorFusion::BATCH_TOLERANCE);
+				examiner.check(batched->gravity().equivalent(sequential->gravity()));
+
+				examiner << "Largest difference " << largest_difference << " degrees." << std::endl;
+				examiner << "Sequential " << (motion_updates.size() / sequential_watch.time()) << " updates/s, batched " << (motion_updates.size() / batched_watch.time()) << " updates/s." << std::endl;
+			}
+		},
+	};
+}
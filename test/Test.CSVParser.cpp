@@ -0,0 +1,64 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/CSVParser.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace TransformFlow {
+	UnitTest::Suite CSVParserTestSuite {
+		"Test CSV Parser Functionality",
+
+		{"Check Rows",
+			[](UnitTest::Examiner & examiner) {
+				const char * text = "1, Gyroscope ,12.5,-0.25,1e-3\r\n\n2,Frame,7.25,42";
+
+				CSVParser parser(text, text + std::strlen(text));
+
+				examiner.check(parser.next_row());
+				examiner.check_equal(parser.row().size(), (std::size_t)5);
+				examiner.check_equal(parser.row().at(1).str(), std::string("Gyroscope"));
+				examiner.check_equal(parser.row().at(1).hash(), hash_name("Gyroscope"));
+				examiner.check_equal(parser.row().at(4).to<double>(), 0.001);
+
+				// Empty lines give a single empty field:
+				examiner.check(parser.next_row());
+				examiner.check_equal(parser.row().size(), (std::size_t)1);
+				examiner.check(parser.row().at(0).empty());
+
+				examiner.check(parser.next_row());
+				examiner.check_equal(parser.row().size(), (std::size_t)4);
+				examiner.check_equal(parser.row().at(2).to<float>(), 7.25f);
+				examiner.check_equal(parser.row().at(3).to<std::size_t>(), (std::size_t)42);
+
+				examiner.check(!parser.next_row());
+			}
+		},
+
+		{"Check Numbers",
+			[](UnitTest::Examiner & examiner) {
+				std::mt19937 generator(5);
+				std::uniform_real_distribution<double> values(-10000, 10000);
+
+				char buffer[64];
+
+				// Parsing should be correctly rounded, the same as strtod:
+				for (std::size_t i = 0; i < 10000; i += 1) {
+					int precision = 1 + i % 17;
+					std::snprintf(buffer, sizeof(buffer), (i % 3) ? "%.*f" : "%.*e", precision, values(generator));
+
+					CSVField field = {buffer, buffer + std::strlen(buffer)};
+
+					examiner.check_equal(field.to<double>(), std::strtod(buffer, nullptr));
+				}
+
+				for (auto text : {"12345678901234567890.5", "1e300", "1e-30", "-0.5", "abc", ""}) {
+					CSVField field = {text, text + std::strlen(text)};
+
+					examiner.check_equal(field.to<double>(), std::strtod(text, nullptr));
+				}
+			}
+		},
+	};
+}
@@ -0,0 +1,99 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/ComposedMotionModel.h>
+#include <TransformFlow/HybridMotionModel.h>
+#include <TransformFlow/VideoStream.h>
+#include <Dream/Imaging/Image.h>
+
+namespace TransformFlow {
+	UnitTest::Suite ComposedMotionModelTestSuite {
+		"Test Composed Motion Model Functionality",
+
+		{"Check Composition",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/bw_256_0deg");
+
+				Ref<MotionModel> basic = new BasicSensorMotionModel;
+				Ref<MotionModel> hybrid = new HybridMotionModel;
+
+				Ref<MotionModel> composed_sensor = new StaticMotionModel<ComposedSensorMotionModel>;
+				Ref<MotionModel> composed_hybrid = new StaticMotionModel<ComposedHybridMotionModel>;
+
+				HeadingUpdate heading_update;
+				heading_update.time_offset = 0;
+				heading_update.magnetic_bearing = heading_update.true_bearing = 10;
+
+				MotionUpdate motion_update;
+				motion_update.gravity = {0, -1, 0};
+				motion_update.rotation_rate = {0, 0.2, 0};
+
+				ImageUpdate image_update;
+				image_update.image_buffer = image;
+				image_update.field_of_view = 55.0_deg;
+
+				for (std::size_t i = 0; i < 10; i += 1) {
+					motion_update.time_offset = image_update.time_offset = i * 0.1;
+
+					for (auto model : {basic, hybrid, composed_sensor, composed_hybrid}) {
+						model->update(&heading_update);
+						model->update(&motion_update);
+						model->update(&image_update);
+					}
+
+					// The composed models are the same as the models they were extracted from:
+					examiner.check_equal(R2D * composed_sensor->bearing(), R2D * basic->bearing());
+					examiner.check_equal(R2D * composed_hybrid->bearing(), R2D * hybrid->bearing());
+					examiner.check(composed_hybrid->gravity().equivalent(hybrid->gravity()));
+				}
+			}
+		},
+
+		{"Check Video Stream",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				Ref<VideoStream> hybrid_stream = new VideoStream(loader, new HybridMotionModel, nullptr, 8, 4);
+				Ref<VideoStream> composed_stream = new VideoStream(loader, new StaticMotionModel<ComposedHybridMotionModel>, nullptr, 8, 4);
+
+				examiner.check_equal(composed_stream->frames().size(), hybrid_stream->frames().size());
+
+				for (std::size_t i = 0; i < composed_stream->frames().size(); i += 1) {
+					auto & expected = hybrid_stream->frames().at(i);
+					auto & video_frame = composed_stream->frames().at(i);
+
+					examiner.check_equal(video_frame.valid, expected.valid);
+
+					if (video_frame.valid)
+						examiner.check_equal(R2D * video_frame.bearing, R2D * expected.bearing);
+				}
+
+				// Resuming from a checkpoint restores the state of both stages:
+				auto & checkpoint = composed_stream->checkpoints().back();
+				auto index = composed_stream->sensor_data()->index();
+
+				VideoStream::resume(loader, index, checkpoint, new StaticMotionModel<ComposedHybridMotionModel>, [&](const VideoStream::VideoFrame & video_frame) {
+					auto & expected = composed_stream->frames().at(video_frame.index);
+
+					if (video_frame.valid)
+						examiner.check_equal(R2D * video_frame.bearing, R2D * expected.bearing);
+				});
+
+				// Snapshots can only be restored into the same kind of model:
+				bool rejected = false;
+
+				try {
+					Ref<MotionModel> basic = new BasicSensorMotionModel;
+					basic->restore(*checkpoint.snapshot);
+				} catch (std::invalid_argument &) {
+					rejected = true;
+				}
+
+				examiner.check(rejected);
+			}
+		},
+	};
+}
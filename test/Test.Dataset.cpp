@@ -0,0 +1,281 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/Dataset.h>
+#include <TransformFlow/SensorIndex.h>
+#include <Dream/Core/Data.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace TransformFlow {
+	// The offset of the given column in a data set, read from the directory which follows the 24 byte file header.
+	static std::size_t column_offset(const std::string & bytes, Dataset::Column column)
+	{
+		std::uint64_t section_count;
+		std::memcpy(&section_count, bytes.data() + 16, sizeof(section_count));
+
+		for (std::size_t i = 0; i < section_count; i += 1) {
+			const char * section = bytes.data() + 24 + i * 24;
+
+			std::uint32_t section_column;
+			std::memcpy(&section_column, section, sizeof(section_column));
+
+			if (section_column == std::uint32_t(column)) {
+				std::uint64_t offset;
+				std::memcpy(&offset, section + 16, sizeof(offset));
+
+				return offset;
+			}
+		}
+
+		throw std::out_of_range("Column not found!");
+	}
+
+	// Whether the data set is rejected, either when it's opened or while its updates are read.
+	static bool rejected(const std::string & bytes)
+	{
+		try {
+			Ref<Dataset> dataset = new Dataset(reinterpret_cast<const ByteT *>(bytes.data()), bytes.size());
+
+			std::size_t motions = 0, locations = 0, headings = 0, frames = 0;
+
+			for (std::size_t i = 0; i < dataset->event_count(); i += 1) {
+				switch (dataset->event(i)) {
+					case Dataset::Event::MOTION: dataset->motion_update(motions++); break;
+					case Dataset::Event::LOCATION: dataset->location_update(locations++); break;
+					case Dataset::Event::HEADING: dataset->heading_update(headings++); break;
+					case Dataset::Event::FRAME: dataset->image_update(frames); dataset->load_frame(frames++); break;
+				}
+			}
+		} catch (std::runtime_error & error) {
+			return true;
+		}
+
+		return false;
+	}
+
+	static bool opened(const std::string & bytes)
+	{
+		try {
+			Ref<Dataset> dataset = new Dataset(reinterpret_cast<const ByteT *>(bytes.data()), bytes.size());
+		} catch (std::runtime_error & error) {
+			return false;
+		}
+
+		return true;
+	}
+
+	UnitTest::Suite DatasetTestSuite {
+		"Test Dataset Functionality",
+
+		{"Check Round Trip",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				std::vector<Shared<SensorUpdate>> sensor_updates;
+
+				for (std::size_t i = 0; i < 10; i += 1) {
+					MotionUpdate motion_update;
+					motion_update.time_offset = 1000.0 + i * 0.01;
+					motion_update.rotation_rate = {0.1f * i, -0.2f, 0.3f};
+					motion_update.acceleration = {0, 0.5f, -0.25f * i};
+					motion_update.gravity = {0, -1, 0.01f * i};
+					sensor_updates.push_back(new MotionUpdate(motion_update));
+
+					if (i % 3 == 0) {
+						HeadingUpdate heading_update;
+						heading_update.time_offset = motion_update.time_offset;
+						heading_update.magnetic_bearing = 10.0 + i;
+						heading_update.true_bearing = 12.5 + i;
+						sensor_updates.push_back(new HeadingUpdate(heading_update));
+					}
+
+					if (i % 5 == 0) {
+						LocationUpdate location_update;
+						location_update.time_offset = motion_update.time_offset;
+						location_update.latitude = -43.5225 + i * 0.0001;
+						location_update.longitude = 172.5813;
+						location_update.altitude = 20.0;
+						location_update.horizontal_accuracy = 5.0;
+						location_update.vertical_accuracy = 10.0;
+						sensor_updates.push_back(new LocationUpdate(location_update));
+					}
+
+					if (i % 2 == 0) {
+						ImageUpdate image_update;
+						image_update.time_offset = motion_update.time_offset;
+						image_update.frame_index = i / 2;
+						image_update.field_of_view = 55.0_deg;
+						sensor_updates.push_back(new ImageUpdate(image_update));
+					}
+				}
+
+				Ref<Image> image = loader->load<Image>("samples/bw_16_0deg");
+
+				std::stringstream output;
+				Dataset::write(output, sensor_updates, [&](std::size_t frame_index) {
+					return loader->data_for_resource("samples/bw_16_0deg")->buffer();
+				});
+
+				std::string bytes = output.str();
+				Ref<Dataset> dataset = new Dataset(reinterpret_cast<const ByteT *>(bytes.data()), bytes.size());
+
+				examiner.check_equal(dataset->event_count(), sensor_updates.size());
+				examiner.check_equal(dataset->motion_count(), (std::size_t)10);
+				examiner.check_equal(dataset->heading_count(), (std::size_t)4);
+				examiner.check_equal(dataset->location_count(), (std::size_t)2);
+				examiner.check_equal(dataset->frame_count(), (std::size_t)5);
+				examiner.check(dataset->has_frame_data());
+
+				std::size_t motion_index = 0, location_index = 0, heading_index = 0, frame_index = 0;
+
+				for (std::size_t i = 0; i < sensor_updates.size(); i += 1) {
+					const SensorUpdate * sensor_update = sensor_updates[i].get();
+
+					if (auto expected = dynamic_cast<const MotionUpdate *>(sensor_update)) {
+						examiner.check(dataset->event(i) == Dataset::Event::MOTION);
+
+						MotionUpdate motion_update = dataset->motion_update(motion_index++);
+						examiner.check_equal(motion_update.time_offset, expected->time_offset);
+						examiner.check_equal(motion_update.rotation_rate, expected->rotation_rate);
+						examiner.check_equal(motion_update.acceleration, expected->acceleration);
+						examiner.check_equal(motion_update.gravity, expected->gravity);
+					} else if (auto expected = dynamic_cast<const LocationUpdate *>(sensor_update)) {
+						examiner.check(dataset->event(i) == Dataset::Event::LOCATION);
+
+						LocationUpdate location_update = dataset->location_update(location_index++);
+						examiner.check_equal(location_update.time_offset, expected->time_offset);
+						examiner.check_equal(location_update.latitude, expected->latitude);
+						examiner.check_equal(location_update.longitude, expected->longitude);
+						examiner.check_equal(location_update.altitude, expected->altitude);
+						examiner.check_equal(location_update.horizontal_accuracy, expected->horizontal_accuracy);
+						examiner.check_equal(location_update.vertical_accuracy, expected->vertical_accuracy);
+					} else if (auto expected = dynamic_cast<const HeadingUpdate *>(sensor_update)) {
+						examiner.check(dataset->event(i) == Dataset::Event::HEADING);
+
+						HeadingUpdate heading_update = dataset->heading_update(heading_index++);
+						examiner.check_equal(heading_update.time_offset, expected->time_offset);
+						examiner.check_equal(heading_update.magnetic_bearing, expected->magnetic_bearing);
+						examiner.check_equal(heading_update.true_bearing, expected->true_bearing);
+					} else if (auto expected = dynamic_cast<const ImageUpdate *>(sensor_update)) {
+						examiner.check(dataset->event(i) == Dataset::Event::FRAME);
+
+						ImageUpdate image_update = dataset->image_update(frame_index);
+						examiner.check_equal(image_update.time_offset, expected->time_offset);
+						examiner.check_equal(image_update.frame_index, expected->frame_index);
+
+						Ref<Image> frame = dataset->load_frame(frame_index++);
+						examiner.check(frame);
+						examiner.check_equal(frame->size(), image->size());
+					}
+				}
+
+				// Truncated files are rejected rather than read out of bounds:
+				bool rejected = false;
+
+				try {
+					Ref<Dataset> truncated = new Dataset(reinterpret_cast<const ByteT *>(bytes.data()), bytes.size() / 2);
+				} catch (std::runtime_error & error) {
+					rejected = true;
+				}
+
+				examiner.check(rejected);
+
+				// The index is built from the event column, with the same positions as reading the data set:
+				Ref<SensorIndex> index = new SensorIndex(*dataset);
+
+				examiner.check_equal(index->size(), sensor_updates.size());
+				examiner.check_equal(index->frame_count(), (std::size_t)5);
+				examiner.check_equal(index->end().offset, (std::uint64_t)sensor_updates.size());
+
+				for (std::size_t frame = 0; frame < index->frame_count(); frame += 1) {
+					auto position = index->position_for_frame(frame);
+
+					examiner.check(dataset->event(position.offset) == Dataset::Event::FRAME);
+					examiner.check_equal(position.frames, (std::uint64_t)frame);
+				}
+			}
+		},
+
+		{"Check Corrupted Files",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				std::vector<Shared<SensorUpdate>> sensor_updates;
+
+				for (std::size_t i = 0; i < 4; i += 1) {
+					MotionUpdate motion_update;
+					motion_update.time_offset = i * 0.1;
+					sensor_updates.push_back(new MotionUpdate(motion_update));
+
+					HeadingUpdate heading_update;
+					heading_update.time_offset = i * 0.1;
+					sensor_updates.push_back(new HeadingUpdate(heading_update));
+
+					ImageUpdate image_update;
+					image_update.time_offset = i * 0.1;
+					image_update.frame_index = i;
+					sensor_updates.push_back(new ImageUpdate(image_update));
+				}
+
+				std::stringstream output;
+				Dataset::write(output, sensor_updates, [&](std::size_t frame_index) {
+					return loader->data_for_resource("samples/bw_16_0deg")->buffer();
+				});
+
+				const std::string bytes = output.str();
+
+				examiner << "The original data set is valid";
+				examiner.check(!rejected(bytes));
+
+				std::size_t events = column_offset(bytes, Dataset::Column::EVENTS);
+
+				{
+					std::string corrupted = bytes;
+					corrupted[events] = 7;
+
+					// Opening a data set doesn't read the events, so that it takes the same time however long it is:
+					examiner << "The events are only checked when they are read";
+					examiner.check(opened(corrupted));
+
+					examiner << "An unknown event is rejected";
+					examiner.check(rejected(corrupted));
+				}
+
+				{
+					// The total number of events is unchanged, but there is one motion event too many:
+					std::string corrupted = bytes;
+					corrupted[events + 1] = char(Dataset::Event::MOTION);
+
+					examiner << "Events which don't match the number of rows of their kind are rejected";
+					examiner.check(rejected(corrupted));
+				}
+
+				std::size_t offsets = column_offset(bytes, Dataset::Column::FRAME_OFFSETS);
+
+				{
+					// Swap the start of the second and third images:
+					std::string corrupted = bytes;
+					std::swap_ranges(corrupted.begin() + offsets + 8, corrupted.begin() + offsets + 16, corrupted.begin() + offsets + 16);
+
+					examiner << "Frame offsets which aren't increasing are rejected";
+					examiner.check(rejected(corrupted));
+				}
+
+				{
+					// Move the end of the last image past the end of the frame data:
+					std::string corrupted = bytes;
+					std::uint64_t offset = bytes.size();
+					std::memcpy(&corrupted[offsets + 4 * 8], &offset, sizeof(offset));
+
+					examiner << "Frame offsets outside the frame data are rejected";
+					examiner.check(rejected(corrupted));
+				}
+			}
+		},
+	};
+}
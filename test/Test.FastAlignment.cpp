@@ -0,0 +1,217 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/FastAlignment.h>
+#include <Dream/Core/Timer.h>
+
+#include <cmath>
+#include <random>
+
+namespace TransformFlow {
+	// Generate a pair of histograms where v[j] = u[j + shift], with random bins where they don't overlap.
+	static void generate_histograms(std::mt19937 & generator, std::size_t size, int shift, HistogramT & u, HistogramT & v)
+	{
+		std::uniform_int_distribution<std::uint16_t> counts(0, 11);
+
+		u.resize(size);
+		v.resize(size);
+
+		for (auto & count : u)
+			count = counts(generator);
+
+		for (std::size_t j = 0; j < size; j += 1) {
+			int i = int(j) + shift;
+
+			v[j] = (i >= 0 && i < int(size)) ? u[i] : counts(generator);
+		}
+	}
+
+	static double time_alignment(const HistogramT & u, const HistogramT & v, int estimate, AlignmentEngine engine, std::size_t repeats)
+	{
+		Dream::Core::Stopwatch watch;
+		watch.start();
+
+		for (std::size_t i = 0; i < repeats; i += 1)
+			align_histograms(u, v, estimate, engine);
+
+		watch.pause();
+
+		return watch.time() / repeats;
+	}
+
+	UnitTest::Suite FastAlignmentTestSuite {
+		"Test Fast Alignment Functionality",
+
+		{"Check Alignment Engines",
+			[](UnitTest::Examiner & examiner) {
+				std::mt19937 generator(1);
+				std::uniform_int_distribution<int> sizes(5, 400), shifts(-20, 20), estimates(-30, 30);
+
+				HistogramT u, v;
+
+				for (std::size_t i = 0; i < 1000; i += 1) {
+					generate_histograms(generator, sizes(generator), shifts(generator), u, v);
+
+					// Histograms of different lengths are also supported:
+					v.resize(sizes(generator), 1);
+
+					int estimate = estimates(generator);
+
+					int search = align_histograms(u, v, estimate, AlignmentEngine::SEARCH);
+					int correlation = align_histograms(u, v, estimate, AlignmentEngine::CORRELATION);
+					int best_first = align_histograms(u, v, estimate, AlignmentEngine::BEST_FIRST);
+
+					examiner.check_equal(correlation, search);
+					examiner.check_equal(best_first, search);
+				}
+			}
+		},
+
+		{"Check Histogram Kernels",
+			[](UnitTest::Examiner & examiner) {
+				std::mt19937 generator(3);
+				std::uniform_int_distribution<std::uint16_t> counts(0, HISTOGRAM_MAXIMUM);
+				std::uniform_int_distribution<std::size_t> sizes(0, 300);
+
+				HistogramT u, v;
+
+				for (std::size_t i = 0; i < 100; i += 1) {
+					u.resize(sizes(generator));
+					v.resize(u.size());
+
+					for (auto & count : u) count = counts(generator);
+					for (auto & count : v) count = counts(generator);
+
+					auto expected = sum_squared_differences(u.data(), v.data(), u.size(), ScanlineKernel::SCALAR);
+
+					for (auto kernel : {ScanlineKernel::SSE4, ScanlineKernel::AVX2}) {
+						if (!histogram_kernel_supported(kernel)) continue;
+
+						examiner.check_equal(sum_squared_differences(u.data(), v.data(), u.size(), kernel), expected);
+					}
+				}
+			}
+		},
+
+		{"Check Pyramid Alignment",
+			[](UnitTest::Examiner & examiner) {
+				std::mt19937 generator(4);
+				std::uniform_real_distribution<RealT> xs(0, 640), ys(0, 480);
+
+				Vec2 size = {640, 480};
+				AlignedBox2 bounds(ZERO, size);
+
+				std::vector<Vec2> points, shifted_points;
+
+				for (std::size_t i = 0; i < 5000; i += 1)
+					points.push_back({xs(generator), ys(generator)});
+
+				for (auto tilted : {false, true}) {
+					Radians<> tilt = R0;
+
+					if (tilted)
+						tilt = 10.0_deg;
+
+					for (auto shift : {-150, -40, 0, 40, 150}) {
+						shifted_points.clear();
+
+						for (auto point : points) {
+							point[X] += shift;
+
+							if (point[X] >= 0 && point[X] < size[X])
+								shifted_points.push_back(point);
+						}
+
+						Ref<FeatureTable> a = new FeatureTable(15, 2, bounds, tilt);
+						a->update(points);
+
+						Ref<FeatureTable> b = new FeatureTable(15, 2, bounds, tilt);
+						b->update(shifted_points);
+
+						// A poor estimate, as if the gyroscope had dropped out, and a good one, in bins:
+						for (auto estimate : {0, shift / 2}) {
+							auto full = align_tables(*a, *b, estimate, AlignmentEngine::AUTOMATIC, AlignmentSearch::FULL);
+							auto pyramid = align_tables(*a, *b, estimate, AlignmentEngine::AUTOMATIC, AlignmentSearch::PYRAMID);
+
+							examiner << (tilted ? "Tilted" : "Level") << ", shift " << shift << ", estimate " << estimate << ": full search " << full.value() << ", pyramid " << pyramid.value() << std::endl;
+
+							examiner.check(std::abs(pyramid.value() - full.value()) < 0.001);
+
+							if (!tilted)
+								examiner.check(std::abs(pyramid.value() - shift) < 1.0);
+						}
+					}
+				}
+			}
+		},
+
+		{"Check Pyramid Bounds",
+			[](UnitTest::Examiner & examiner) {
+				std::mt19937 generator(5);
+				std::uniform_real_distribution<RealT> xs(0, 64), ys(0, 480);
+
+				// A narrow image, so that the coarsest level of the pyramid only has a few bins:
+				Vec2 size = {64, 480};
+				AlignedBox2 bounds(ZERO, size);
+
+				std::vector<Vec2> points, shifted_points;
+
+				for (std::size_t i = 0; i < 500; i += 1)
+					points.push_back({xs(generator), ys(generator)});
+
+				for (auto point : points) {
+					point[X] += 12;
+
+					if (point[X] >= 0 && point[X] < size[X])
+						shifted_points.push_back(point);
+				}
+
+				Ref<FeatureTable> a = new FeatureTable(15, 2, bounds, R0);
+				a->update(points);
+
+				Ref<FeatureTable> b = new FeatureTable(15, 2, bounds, R0);
+				b->update(shifted_points);
+
+				// The refinement windows around the coarse offset extend past the offsets a full search would consider, so they must be clamped:
+				for (auto estimate : {-15, 0, 6, 15}) {
+					auto full = align_tables(*a, *b, estimate, AlignmentEngine::AUTOMATIC, AlignmentSearch::FULL);
+					auto pyramid = align_tables(*a, *b, estimate, AlignmentEngine::AUTOMATIC, AlignmentSearch::PYRAMID);
+
+					examiner << "Estimate " << estimate << ": full search " << full.value() << ", pyramid " << pyramid.value() << std::endl;
+
+					examiner << "The pyramid found an overlap within the image";
+					examiner.check(pyramid.number_of_samples() > 0);
+					examiner.check(std::abs(pyramid.value()) < size[X] / 2);
+				}
+			}
+		},
+
+		{"Benchmark Alignment Engines",
+			[](UnitTest::Examiner & examiner) {
+				std::mt19937 generator(2);
+
+				HistogramT u, v;
+
+				// The search engine stops evaluating each offset once it's worse than the best so far, so it is fastest when the estimate is close to the actual offset:
+				for (auto size : {100, 300, 1000, 3000, 10000}) {
+					for (auto poor_estimate : {false, true}) {
+						int shift = poor_estimate ? size / 5 : 3;
+
+						generate_histograms(generator, size, shift, u, v);
+
+						std::size_t repeats = 10000 / size + 1;
+
+						auto search = time_alignment(u, v, 0, AlignmentEngine::SEARCH, repeats);
+						auto correlation = time_alignment(u, v, 0, AlignmentEngine::CORRELATION, repeats);
+						auto best_first = time_alignment(u, v, 0, AlignmentEngine::BEST_FIRST, repeats);
+
+						examiner << "Size " << size << (poor_estimate ? " (poor estimate)" : " (good estimate)") << ": search " << search * 1000000.0 << "us, correlation " << correlation * 1000000.0 << "us, best first " << best_first * 1000000.0 << "us" << std::endl;
+
+						examiner.check_equal(align_histograms(u, v, 0, AlignmentEngine::CORRELATION), align_histograms(u, v, 0, AlignmentEngine::SEARCH));
+					}
+				}
+
+				examiner << "Correlation engine threshold: " << CORRELATION_ENGINE_THRESHOLD << " bins" << std::endl;
+			}
+		},
+	};
+}
@@ -1,9 +1,37 @@
 
 #include <UnitTest/UnitTest.h>
 #include <TransformFlow/FeaturePoints.h>
+#include <TransformFlow/MotionModel.h>
 #include <Dream/Imaging/Image.h>
 #include <Euclid/Numerics/Vector.IO.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+// Count allocations, so that we can check that scanning in steady state doesn't allocate. Allocations are only counted while a test enables counting, so the rest of the test runner is unaffected:
+static std::atomic<bool> counting_allocations(false);
+static std::atomic<std::size_t> allocation_count(0);
+
+void * operator new(std::size_t size)
+{
+	if (counting_allocations)
+		allocation_count += 1;
+
+	if (void * pointer = std::malloc(size ? size : 1))
+		return pointer;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void * pointer) noexcept
+{
+	std::free(pointer);
+}
+
 namespace TransformFlow {
 	UnitTest::Suite FeaturePointsTestSuite {
 		"Test Feature Points Functionality",
@@ -36,6 +64,237 @@ namespace TransformFlow {
 					examiner.check_equal(offsets[0][X], 15.5);
 				}
 			}
+		},
+
+		{"Check Kernels",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				std::vector<Ref<Image>> images = {
+					loader->load<Image>("samples/bw_16_0deg"),
+					loader->load<Image>("samples/bw_16_1g"),
+					loader->load<Image>("samples/bw_256_0deg")
+				};
+
+				std::vector<Radians<>> tilts = {R0, 10.0_deg, -35.0_deg, R90};
+
+				for (auto kernel : {ScanlineKernel::SSE4, ScanlineKernel::AVX2}) {
+					if (!kernel_supported(kernel)) {
+						examiner << "Kernel " << (int)kernel << " is not supported by this processor";
+						continue;
+					}
+
+					for (auto image : images) {
+						for (auto tilt : tilts) {
+							Ref<FeaturePoints> scalar = new FeaturePoints(ScanlineKernel::SCALAR);
+							Ref<FeaturePoints> vectorized = new FeaturePoints(kernel);
+
+							scalar->scan(image, tilt);
+							vectorized->scan(image, tilt);
+
+							auto & expected = scalar->offsets();
+							auto & actual = vectorized->offsets();
+
+							examiner << "Kernel " << (int)kernel << " found the same number of offsets";
+							examiner.check_equal(actual.size(), expected.size());
+
+							bool identical = actual.size() == expected.size();
+
+							for (std::size_t i = 0; identical && i < actual.size(); i += 1)
+								identical = actual[i] == expected[i];
+
+							examiner << "Kernel " << (int)kernel << " offsets are identical to scalar offsets";
+							examiner.check(identical);
+						}
+					}
+				}
+			}
+		},
+
+		{"Check Parallel Scan",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/bw_256_0deg");
+				Ref<ThreadPool> thread_pool = new ThreadPool(4);
+
+				for (auto tilt : {R0, 10.0_deg, -35.0_deg}) {
+					Ref<FeaturePoints> serial = new FeaturePoints();
+					Ref<FeaturePoints> parallel = new FeaturePoints();
+					parallel->set_thread_pool(thread_pool);
+
+					serial->scan(image, tilt, 5);
+					parallel->scan(image, tilt, 5);
+
+					examiner << "Parallel scan produced the same segments";
+					examiner.check_equal(parallel->segments().size(), serial->segments().size());
+
+					examiner << "Parallel scan produced the same offsets";
+					examiner.check(parallel->offsets() == serial->offsets());
+
+					examiner << "Parallel scan produced the same feature table";
+					examiner.check(parallel->table()->bin_counts() == serial->table()->bin_counts());
+				}
+			}
+		},
+
+		{"Check Resampled Scan",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				for (auto name : {"samples/bw_16_0deg", "samples/bw_16_1g"}) {
+					Ref<Image> image = loader->load<Image>(name);
+
+					Ref<FeaturePoints> feature_points = new FeaturePoints();
+					feature_points->set_mode(ScanMode::RESAMPLED);
+					feature_points->scan(image, R0);
+
+					auto & offsets = feature_points->offsets();
+
+					examiner << "Resampled scan found edges in " << name;
+					examiner.check(offsets.size() > 0);
+
+					if (offsets.size() > 0) {
+						examiner << "Offset " << offsets[0] << " is in the middle";
+						examiner.check(std::abs(offsets[0][X] - 15.5) < 0.5);
+					}
+				}
+			}
+		},
+
+		{"Check Resampled Tilt",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				std::vector<Radians<>> tilts = {10.0_deg, -35.0_deg, 60.0_deg};
+
+				for (auto name : {"samples/bw_16_0deg", "samples/bw_256_0deg"}) {
+					Ref<Image> image = loader->load<Image>(name);
+
+					for (auto tilt : tilts) {
+						Ref<FeaturePoints> lines = new FeaturePoints();
+						Ref<FeaturePoints> resampled = new FeaturePoints();
+						resampled->set_mode(ScanMode::RESAMPLED);
+
+						lines->scan(image, tilt, 5);
+						resampled->scan(image, tilt, 5);
+
+						examiner << "Both modes scanned the same segments of " << name;
+						examiner.check_equal(resampled->segments().size(), lines->segments().size());
+
+						auto & expected = lines->offsets();
+						auto & actual = resampled->offsets();
+
+						examiner << "Resampled scan found " << actual.size() << " edges in " << name << ", and the line scan found " << expected.size();
+						examiner.check(actual.size() > 0);
+						examiner.check(std::abs(RealT(actual.size()) - RealT(expected.size())) <= 0.25 * expected.size());
+
+						// The resampled rows are interpolated, while the lines are walked pixel by pixel, so the edges are in nearly the same place, but not exactly:
+						RealT total_distance = 0;
+
+						for (auto & offset : actual) {
+							RealT nearest = std::numeric_limits<RealT>::max();
+
+							for (auto & other : expected)
+								nearest = std::min(nearest, (offset - other).length());
+
+							total_distance += nearest;
+						}
+
+						RealT mean_distance = actual.size() ? total_distance / actual.size() : 0;
+
+						examiner << "Resampled edges are on average " << mean_distance << " pixels from the line scan edges";
+						examiner.check(mean_distance < 1.0);
+					}
+				}
+			}
+		},
+
+		{"Check Pixel Layouts",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/bw_256_0deg");
+				PixelPlane rgb = PixelPlane::for_image(image);
+
+				// Build an NV12 style buffer, with padded luma rows followed by an interleaved chroma plane:
+				const std::size_t stride = rgb.width + 64;
+				std::vector<ByteT> buffer(stride * rgb.height + stride * (rgb.height / 2), 128);
+
+				for (std::size_t y = 0; y < rgb.height; y += 1) {
+					for (std::size_t x = 0; x < rgb.width; x += 1) {
+						buffer[y * stride + x] = RGBPixel::intensity(rgb.pixel(x, y));
+					}
+				}
+
+				PixelPlane luma = PixelPlane::for_luma(buffer.data(), rgb.width, rgb.height, stride);
+
+				for (auto tilt : {R0, 10.0_deg, -35.0_deg}) {
+					Ref<FeaturePoints> expected = new FeaturePoints();
+					Ref<FeaturePoints> actual = new FeaturePoints();
+
+					expected->scan(image, tilt);
+					actual->scan(luma, tilt);
+
+					// The sample image is black and white, so the luma plane has exactly the same intensities:
+					examiner << "Scanning the luma plane produced the same offsets as the RGB image";
+					examiner.check(actual->offsets() == expected->offsets());
+				}
+			}
+		},
+
+		{"Check Steady State Allocations",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/bw_256_0deg");
+				std::vector<Radians<>> tilts = {R0, 10.0_deg, -35.0_deg, 5.0_deg};
+
+				// The image is given to the motion model by an image update, which is scanned directly:
+				ImageUpdate image_update;
+				image_update.image_buffer = image;
+
+				// This only covers scanning and aligning without a thread pool. The notes which VisionCorrection adds to each image update, and dispatching a parallel scan, still allocate:
+				for (auto mode : {ScanMode::LINES, ScanMode::RESAMPLED}) {
+					Ref<FeaturePointsPool> pool = new FeaturePointsPool;
+					Ref<FeaturePoints> previous;
+
+					// Process frames in the same way as VisionCorrection, keeping the previous frame while scanning the next:
+					auto process_frame = [&](std::size_t frame) {
+						Ref<FeaturePoints> current = pool->acquire();
+						current->set_mode(mode);
+						current->scan(image_update, tilts[frame % tilts.size()]);
+
+						if (previous)
+							previous->table()->calculate_offset(*current->table());
+
+						pool->release(previous);
+						previous = current;
+					};
+
+					// Warm up, so that all buffers reach their steady state capacity:
+					for (std::size_t frame = 0; frame < tilts.size() * 4; frame += 1)
+						process_frame(frame);
+
+					allocation_count = 0;
+					counting_allocations = true;
+
+					for (std::size_t frame = 0; frame < tilts.size() * 4; frame += 1)
+						process_frame(frame);
+
+					counting_allocations = false;
+					std::size_t allocations = allocation_count;
+
+					examiner << "Scanning and aligning in steady state made " << allocations << " allocations";
+					examiner.check_equal(allocations, (std::size_t)0);
+				}
+			}
 		}
 	};
 }
@@ -0,0 +1,48 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/FrameCache.h>
+#include <Dream/Resources/Loader.h>
+
+namespace TransformFlow {
+	UnitTest::Suite FrameCacheTestSuite {
+		"Test Frame Cache Functionality",
+
+		{"Check Bounded Memory",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				// Every frame is the same image, but each load decodes it again:
+				Ref<FrameCache> frame_cache = new FrameCache([&](std::size_t index) {
+					return loader->load<Image>("samples/bw_256_0deg");
+				});
+
+				Ref<Image> image = frame_cache->frame(0);
+				std::size_t frame_size = FrameCache::byte_size(image);
+
+				examiner.check(frame_size > 0);
+				examiner.check_equal(frame_cache->frame(0), image);
+				examiner.check_equal(frame_cache->loads(), (std::size_t)1);
+
+				frame_cache->set_budget(frame_size * 3);
+
+				// A sequential replay only keeps the most recent frames:
+				for (std::size_t i = 0; i < 100; i += 1) {
+					examiner.check(frame_cache->frame(i));
+					examiner.check(frame_cache->size() <= frame_cache->budget());
+				}
+
+				examiner.check_equal(frame_cache->count(), (std::size_t)3);
+				examiner.check_equal(frame_cache->loads(), (std::size_t)100);
+
+				// Recently used frames are still cached:
+				frame_cache->frame(98);
+				examiner.check_equal(frame_cache->loads(), (std::size_t)100);
+
+				// The frame used least recently was released:
+				frame_cache->frame(0);
+				examiner.check_equal(frame_cache->loads(), (std::size_t)101);
+			}
+		},
+	};
+}
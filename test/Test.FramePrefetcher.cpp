@@ -0,0 +1,131 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/FramePrefetcher.h>
+#include <Dream/Core/Timer.h>
+#include <Dream/Resources/Loader.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace TransformFlow {
+	UnitTest::Suite FramePrefetcherTestSuite {
+		"Test Frame Prefetcher Functionality",
+
+		{"Check Ordered Prefetching",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				const std::size_t FRAMES = 40, DEPTH = 4;
+
+				std::atomic<std::size_t> loaded(0), consumed(0), furthest_ahead(0), loading(0), most_loading(0);
+
+				// Simulate slow decoding, and keep track of how far ahead of the consumer it gets, and how many images are decoded at once:
+				Ref<FrameCache> frame_cache = new FrameCache([&](std::size_t index) {
+					std::size_t concurrent = loading += 1;
+					if (concurrent > most_loading) most_loading = concurrent;
+
+					std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+					std::size_t ahead = index + 1 - consumed;
+					if (ahead > furthest_ahead) furthest_ahead = ahead;
+
+					loading -= 1;
+					loaded += 1;
+					return loader->load<Image>("samples/bw_16_0deg");
+				});
+
+				std::vector<Shared<SensorUpdate>> sensor_updates;
+
+				for (std::size_t i = 0; i < FRAMES; i += 1) {
+					sensor_updates.push_back(new MotionUpdate);
+
+					ImageUpdate image_update;
+					image_update.frame_index = i;
+					image_update.frame_cache = frame_cache;
+					sensor_updates.push_back(new ImageUpdate(image_update));
+				}
+
+				auto replay = [&](std::size_t depth) {
+					frame_cache->clear();
+					loaded = 0;
+					consumed = 0;
+					furthest_ahead = 0;
+					most_loading = 0;
+
+					Ref<ThreadPool> thread_pool = new ThreadPool(4);
+					FramePrefetcher prefetcher(sensor_updates, thread_pool, depth);
+
+					Dream::Core::Stopwatch watch;
+					watch.start();
+
+					for (std::size_t i = 0; i < FRAMES; i += 1) {
+						Ref<Image> image = prefetcher.next();
+						examiner.check(image);
+
+						// The image is handed over in order, and is still cached:
+						examiner.check_equal(frame_cache->frame(i), image);
+
+						consumed += 1;
+					}
+
+					examiner.check(!prefetcher.next());
+
+					watch.pause();
+
+					return watch.time();
+				};
+
+				auto serial_time = replay(0);
+				examiner.check_equal(loaded.load(), FRAMES);
+
+				examiner << "Without prefetching, one image is loaded at a time";
+				examiner.check_equal(most_loading.load(), (std::size_t)1);
+
+				auto prefetch_time = replay(DEPTH);
+				examiner.check_equal(loaded.load(), FRAMES);
+
+				// The decoders are never more than DEPTH images ahead of the consumer:
+				examiner.check(furthest_ahead <= DEPTH);
+
+				examiner << "Prefetching loads several images at once";
+				examiner.check(most_loading > 1);
+
+				// The times depend on the machine, so they are only reported:
+				examiner << "Serial loading " << serial_time * 1000.0 << "ms, prefetching " << prefetch_time * 1000.0 << "ms" << std::endl;
+			}
+		},
+
+		{"Check Pushed Updates",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<FrameCache> frame_cache = new FrameCache([&](std::size_t index) {
+					return loader->load<Image>(index % 2 ? "samples/bw_16_1g" : "samples/bw_16_0deg");
+				});
+
+				FramePrefetcher prefetcher(new ThreadPool(2), 3);
+
+				examiner.check(!prefetcher.next());
+
+				// Images can be handed over while more updates are still being added, as when streaming:
+				for (std::size_t i = 0; i < 10; i += 1) {
+					ImageUpdate image_update;
+					image_update.frame_index = i;
+					image_update.frame_cache = frame_cache;
+
+					prefetcher.push(new ImageUpdate(image_update));
+
+					if (i >= 2)
+						examiner.check_equal(prefetcher.next(), frame_cache->frame(i - 2));
+				}
+
+				examiner.check_equal(prefetcher.next(), frame_cache->frame(8));
+				examiner.check_equal(prefetcher.next(), frame_cache->frame(9));
+				examiner.check(!prefetcher.next());
+			}
+		},
+	};
+}
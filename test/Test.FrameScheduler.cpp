@@ -0,0 +1,70 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/FrameScheduler.h>
+
+namespace TransformFlow {
+	UnitTest::Suite FrameSchedulerTestSuite {
+		"Test Frame Scheduler Functionality",
+
+		{"Check Unlimited Budget",
+			[](UnitTest::Examiner & examiner) {
+				FrameScheduler scheduler(15);
+
+				for (std::size_t i = 0; i < 100; i += 1) {
+					examiner.check(scheduler.should_scan(i * 0.01));
+					scheduler.record_scan(1.0);
+				}
+
+				examiner.check_equal(scheduler.quality().dy, (std::size_t)15);
+				examiner.check_equal(scheduler.dropped_frames(), (std::size_t)0);
+				examiner.check_equal(scheduler.quality_changes(), (std::size_t)0);
+			}
+		},
+
+		{"Check Adaptive Quality",
+			[](UnitTest::Examiner & examiner) {
+				FrameScheduler scheduler(15);
+				scheduler.set_budget(0.02);
+
+				// Scan time is proportional to the number of scanlines, and frames arrive at 30fps:
+				auto scan_time = [&]() {
+					return 0.05 * 15.0 / scheduler.quality().dy;
+				};
+
+				TimeT frame_time = 0;
+
+				for (std::size_t i = 0; i < 200; i += 1, frame_time += 1.0/30.0) {
+					if (scheduler.should_scan(frame_time))
+						scheduler.record_scan(scan_time());
+				}
+
+				examiner << "Settled on dy = " << scheduler.quality().dy << " after " << scheduler.quality_changes() << " changes, dropping " << scheduler.dropped_frames() << " of 200 frames." << std::endl;
+
+				examiner.check(scan_time() <= scheduler.budget());
+				examiner.check(scheduler.quality_changes() > 0);
+
+				// Frames are only dropped while the scan time is longer than the time between frames:
+				examiner.check(scheduler.dropped_frames() > 0);
+				examiner.check_equal(scheduler.dropped_frames() + scheduler.scanned_frames(), (std::size_t)200);
+
+				std::size_t dropped_frames = scheduler.dropped_frames();
+
+				for (std::size_t i = 0; i < 100; i += 1, frame_time += 1.0/30.0) {
+					examiner.check(scheduler.should_scan(frame_time));
+					scheduler.record_scan(scan_time());
+				}
+
+				examiner.check_equal(scheduler.dropped_frames(), dropped_frames);
+
+				// When the scans get faster, the quality is restored:
+				for (std::size_t i = 0; i < 100; i += 1, frame_time += 1.0/30.0) {
+					if (scheduler.should_scan(frame_time))
+						scheduler.record_scan(0.001);
+				}
+
+				examiner.check_equal(scheduler.level(), (std::size_t)0);
+				examiner.check_equal(scheduler.quality().dy, (std::size_t)15);
+			}
+		},
+	};
+}
@@ -0,0 +1,202 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/HybridMotionModel.h>
+#include <Dream/Imaging/Image.h>
+
+#include <cmath>
+#include <stdexcept>
+
+namespace TransformFlow {
+	UnitTest::Suite HybridMotionModelTestSuite {
+		"Test Hybrid Motion Model Functionality",
+
+		{"Check Asynchronous Vision",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/bw_256_0deg");
+
+				Ref<HybridMotionModel> synchronous = new HybridMotionModel;
+				Ref<HybridMotionModel> asynchronous = new HybridMotionModel;
+
+				asynchronous->set_asynchronous(true);
+
+				HeadingUpdate heading_update;
+				heading_update.time_offset = 0;
+				heading_update.magnetic_bearing = heading_update.true_bearing = 10;
+
+				MotionUpdate motion_update;
+				motion_update.gravity = {0, -1, 0};
+				motion_update.rotation_rate = {0, 0.2, 0};
+
+				ImageUpdate image_update;
+				image_update.image_buffer = image;
+				image_update.field_of_view = 55.0_deg;
+
+				// Sensor updates are applied through the generic interface, in the same way as VideoStream:
+				auto update = [](MotionModel & model, SensorUpdate & sensor_update) {
+					model.update(&sensor_update);
+				};
+
+				for (std::size_t i = 0; i < 10; i += 1) {
+					motion_update.time_offset = image_update.time_offset = i * 0.1;
+
+					for (auto model : {synchronous, asynchronous}) {
+						update(*model, heading_update);
+						update(*model, motion_update);
+						update(*model, image_update);
+					}
+
+					// If nothing happens between the image and applying its result, the result should be the same:
+					asynchronous->flush();
+
+					examiner.check_equal(asynchronous->pending_frames(), (std::size_t)0);
+					examiner.check_equal(asynchronous->vision_lag(), 0.0);
+
+					RealT synchronous_bearing = R2D * synchronous->bearing();
+					RealT asynchronous_bearing = R2D * asynchronous->bearing();
+
+					examiner.check_equal(asynchronous_bearing, synchronous_bearing);
+				}
+
+				// Sensor updates continue to be processed while images are being scanned:
+				for (std::size_t i = 10; i < 20; i += 1) {
+					motion_update.time_offset = image_update.time_offset = i * 0.1;
+
+					update(*asynchronous, motion_update);
+					update(*asynchronous, image_update);
+
+					examiner.check(asynchronous->vision_lag() <= (i - 9) * 0.1 + 0.001);
+				}
+
+				asynchronous->flush();
+
+				examiner.check_equal(asynchronous->pending_frames(), (std::size_t)0);
+				examiner << "Dropped " << asynchronous->dropped_frames() << " of 10 frames." << std::endl;
+			}
+		},
+
+		{"Check Quality Change",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/bw_256_0deg");
+
+				HeadingUpdate heading_update;
+				heading_update.time_offset = 0;
+				heading_update.magnetic_bearing = heading_update.true_bearing = 10;
+
+				// The device rotates by about 11 degrees between frames, so every frame becomes the tracking reference:
+				MotionUpdate motion_update;
+				motion_update.gravity = {0, -1, 0};
+				motion_update.rotation_rate = {0, 0.2, 0};
+
+				const TimeT FRAME_INTERVAL = 1.0;
+				RealT gyro_rotation = R2D * motion_update.gravity.dot(motion_update.rotation_rate) * FRAME_INTERVAL;
+
+				ImageUpdate image_update;
+				image_update.image_buffer = image;
+				image_update.field_of_view = 55.0_deg;
+
+				// Every scan takes longer than the budget, so the scheduler lowers the quality every FrameScheduler::ADAPTATION_SCANS frames:
+				Ref<HybridMotionModel> model = new HybridMotionModel;
+				model->scheduler().set_budget(1e-9);
+
+				RealT previous_bearing = 0;
+				std::size_t previous_level = 0, quality_changes = 0;
+
+				for (std::size_t i = 0; i < 25; i += 1) {
+					motion_update.time_offset = image_update.time_offset = i * FRAME_INTERVAL;
+
+					// The quality used to scan this frame:
+					std::size_t level = model->scheduler().level();
+
+					model->update(&heading_update);
+					model->update(&motion_update);
+					model->update(&image_update);
+
+					RealT bearing = R2D * model->bearing();
+
+					// The frame can't be aligned with the previous one, so the bearing follows the gyroscope:
+					if (i > 0 && level != previous_level) {
+						RealT difference = std::remainder(bearing - previous_bearing - gyro_rotation, RealT(360));
+						examiner.check(std::abs(difference) < 1e-3);
+
+						quality_changes += 1;
+					}
+
+					previous_bearing = bearing;
+					previous_level = level;
+				}
+
+				examiner.check_equal(quality_changes, (std::size_t)2);
+			}
+		},
+
+		{"Check Snapshot",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/bw_256_0deg");
+
+				HeadingUpdate heading_update;
+				heading_update.time_offset = 0;
+				heading_update.magnetic_bearing = heading_update.true_bearing = 10;
+
+				MotionUpdate motion_update;
+				motion_update.gravity = {0, -1, 0};
+				motion_update.rotation_rate = {0, 0.2, 0};
+
+				ImageUpdate image_update;
+				image_update.image_buffer = image;
+				image_update.field_of_view = 55.0_deg;
+
+				auto step = [&](MotionModel & model, std::size_t i) {
+					motion_update.time_offset = image_update.time_offset = i * 0.1;
+
+					model.update(&heading_update);
+					model.update(&motion_update);
+					model.update(&image_update);
+
+					return R2D * model.bearing();
+				};
+
+				Ref<HybridMotionModel> model = new HybridMotionModel;
+				Ref<MotionModel::Snapshot> snapshot;
+				std::vector<RealT> bearings;
+
+				for (std::size_t i = 0; i < 20; i += 1) {
+					if (i == 10)
+						snapshot = model->snapshot();
+
+					RealT bearing = step(*model, i);
+
+					if (i >= 10)
+						bearings.push_back(bearing);
+				}
+
+				// The model kept going after the snapshot, which must not have changed it:
+				Ref<HybridMotionModel> restored = new HybridMotionModel;
+				restored->restore(*snapshot);
+
+				for (std::size_t i = 10; i < 20; i += 1)
+					examiner.check_equal(step(*restored, i), bearings[i - 10]);
+
+				// Snapshots can only be restored into the same kind of model:
+				bool rejected = false;
+
+				try {
+					Ref<BasicSensorMotionModel> basic = new BasicSensorMotionModel;
+					basic->restore(*snapshot);
+				} catch (std::invalid_argument & error) {
+					rejected = true;
+				}
+
+				examiner.check(rejected);
+			}
+		},
+	};
+}
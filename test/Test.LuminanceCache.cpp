@@ -0,0 +1,112 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/LuminanceCache.h>
+#include <TransformFlow/FeaturePoints.h>
+#include <TransformFlow/MotionModel.h>
+#include <Dream/Imaging/Image.h>
+
+namespace TransformFlow {
+	UnitTest::Suite LuminanceCacheTestSuite {
+		"Test Luminance Cache Functionality",
+
+		{"Check Luminance",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> image = loader->load<Image>("samples/red_green_32");
+				Ref<Luminance> luminance = new Luminance(image);
+
+				PixelPlane plane = luminance->plane();
+				examiner.check_equal(plane.width, (std::size_t)32);
+				examiner.check_equal(plane.height, (std::size_t)32);
+				examiner.check_equal(plane.channels, (std::size_t)1);
+
+				// Weighted luma, so red and green have different intensities, even though their channel averages are the same:
+				examiner << "Red and green have different luminance";
+				examiner.check(*plane.pixel(0, 0) < *plane.pixel(31, 0));
+
+				// The colour image is kept alive with its greyscale copy, so both are counted:
+				examiner << "The size includes the image as well as the greyscale copy";
+				examiner.check_equal(luminance->byte_size(), (std::size_t)(32 * 32 * 3 + 32 * 32));
+			}
+		},
+
+		{"Check Cache",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				Ref<Image> a = loader->load<Image>("samples/bw_16_0deg");
+				Ref<Image> b = loader->load<Image>("samples/bw_16_1g");
+				Ref<Image> c = loader->load<Image>("samples/bw_256_0deg");
+
+				Ref<LuminanceCache> cache = new LuminanceCache;
+
+				Ref<Luminance> luminance_a = cache->luminance_for(a);
+				Ref<Luminance> luminance_b = cache->luminance_for(b);
+				Ref<Luminance> luminance_c = cache->luminance_for(c);
+
+				examiner << "Each image was converted once";
+				examiner.check_equal(cache->count(), (std::size_t)3);
+				examiner.check_equal(cache->size(), luminance_a->byte_size() + luminance_b->byte_size() + luminance_c->byte_size());
+
+				examiner << "Looking up the same image again is a hit";
+				examiner.check(cache->luminance_for(a) == luminance_a);
+				examiner.check_equal(cache->count(), (std::size_t)3);
+
+				// a was used more recently than b, so b is evicted first:
+				cache->set_budget(luminance_a->byte_size() + luminance_c->byte_size());
+
+				examiner << "The least recently used entry was evicted";
+				examiner.check_equal(cache->count(), (std::size_t)2);
+				examiner.check_equal(cache->size(), luminance_a->byte_size() + luminance_c->byte_size());
+				examiner.check(cache->luminance_for(a) == luminance_a);
+				examiner.check(cache->luminance_for(c) == luminance_c);
+
+				// The most recently used entry is kept, even though it's larger than the budget:
+				cache->set_budget(0);
+
+				examiner << "Only the most recently used entry is kept";
+				examiner.check_equal(cache->count(), (std::size_t)1);
+				examiner.check(cache->luminance_for(c) == luminance_c);
+
+				examiner << "An evicted image is converted again";
+				examiner.check(cache->luminance_for(b) != luminance_b);
+				examiner.check_equal(cache->count(), (std::size_t)1);
+
+				cache->clear();
+				examiner.check_equal(cache->count(), (std::size_t)0);
+				examiner.check_equal(cache->size(), (std::size_t)0);
+			}
+		},
+
+		{"Check Feature Points",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow");
+				loader->add_loader(new Image::Loader);
+
+				// The left half is red and the right half is green, which only have an edge between them in weighted luma:
+				Ref<Image> image = loader->load<Image>("samples/red_green_32");
+
+				ImageUpdate image_update;
+				image_update.image_buffer = image;
+
+				Ref<FeaturePoints> expected = new FeaturePoints();
+				Ref<FeaturePoints> actual = new FeaturePoints();
+				Ref<FeaturePoints> luma = new FeaturePoints();
+
+				expected->scan(image, R0, 5);
+				actual->scan(image_update, R0, 5);
+				luma->scan(image_update.luminance()->plane(), R0, 5);
+
+				examiner << "Scanning an image update averages the colour channels, the same as scanning the image";
+				examiner.check(actual->offsets() == expected->offsets());
+
+				examiner << "The averaged channels have no edge, but the luminance does";
+				examiner.check_equal(expected->offsets().size(), (std::size_t)0);
+				examiner.check(luma->offsets().size() > 0);
+			}
+		},
+	};
+}
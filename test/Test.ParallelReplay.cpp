@@ -0,0 +1,100 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/ParallelReplay.h>
+#include <TransformFlow/HybridMotionModel.h>
+
+namespace TransformFlow {
+	UnitTest::Suite ParallelReplayTestSuite {
+		"Test Parallel Replay Functionality",
+
+		{"Check Models",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				std::function<Ref<MotionModel>(std::size_t)> make_model = [](std::size_t i) -> Ref<MotionModel> {
+					switch (i) {
+						case 0: return new BasicSensorMotionModel;
+						case 1: return new HybridMotionModel(15);
+						default: return new HybridMotionModel(8);
+					}
+				};
+
+				std::vector<Ref<MotionModel>> motion_models;
+
+				for (std::size_t i = 0; i < 3; i += 1)
+					motion_models.push_back(make_model(i));
+
+				// A small window, so that the models have to wait for each other:
+				Ref<ParallelReplay> parallel_replay = new ParallelReplay(loader, nullptr, 2);
+				auto results = parallel_replay->run(motion_models);
+
+				// Each image was only decoded once:
+				auto frame_cache = parallel_replay->sensor_data()->frame_cache();
+				examiner.check_equal(frame_cache->loads(), (std::size_t)12);
+
+				examiner.check_equal(results.size(), motion_models.size());
+
+				for (std::size_t i = 0; i < results.size(); i += 1) {
+					auto & result = results[i];
+
+					examiner.check(result.motion_model == motion_models[i]);
+					examiner.check(!result.error);
+
+					// The results are the same as replaying each model on its own:
+					Ref<VideoStream> video_stream = new VideoStream(loader, make_model(i));
+
+					examiner.check_equal(result.frames.size(), video_stream->frames().size());
+
+					for (std::size_t j = 0; j < result.frames.size(); j += 1) {
+						auto & video_frame = result.frames[j];
+						auto & expected = video_stream->frames().at(j);
+
+						examiner.check_equal(video_frame.index, expected.index);
+						examiner.check_equal(video_frame.valid, expected.valid);
+						examiner.check_equal(video_frame.image_update->frame_index, expected.image_update->frame_index);
+
+						if (video_frame.valid)
+							examiner.check_equal(R2D * video_frame.bearing, R2D * expected.bearing);
+					}
+
+					examiner << "Model " << i << ": " << result.update_time << "s updating, " << result.wait_time << "s waiting for images." << std::endl;
+				}
+			}
+		},
+
+		{"Check Missing Frame",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				Ref<SensorData> sensor_data = new SensorData(loader);
+				Ref<FrameCache> frame_cache = sensor_data->frame_cache();
+
+				// As if frame 5 had no stored data, see Dataset::load_frame:
+				Ref<FrameCache> missing_frame_cache = new FrameCache([frame_cache](std::size_t index) -> Ref<Image> {
+					if (index == 5)
+						return nullptr;
+
+					return frame_cache->frame(index);
+				});
+
+				for (auto & sensor_update : sensor_data->sensor_updates()) {
+					if (Shared<ImageUpdate> image_update = sensor_update)
+						image_update->frame_cache = missing_frame_cache;
+				}
+
+				// The models don't use the images, so the missing frame is replayed like any other:
+				Ref<ParallelReplay> parallel_replay = new ParallelReplay(sensor_data, nullptr, 2);
+				auto results = parallel_replay->run({new BasicSensorMotionModel, new BasicSensorMotionModel});
+
+				examiner.check_equal(results.size(), (std::size_t)2);
+
+				for (auto & result : results) {
+					examiner.check(!result.error);
+					examiner.check_equal(result.frames.size(), (std::size_t)12);
+				}
+			}
+		},
+	};
+}
@@ -0,0 +1,111 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/SensorEvents.h>
+#include <TransformFlow/BasicSensorMotionModel.h>
+#include <Dream/Core/Timer.h>
+
+#include <cmath>
+
+namespace TransformFlow {
+	UnitTest::Suite SensorEventsTestSuite {
+		"Test Sensor Events Functionality",
+
+		{"Check Visiting",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				std::vector<Shared<SensorUpdate>> sensor_updates;
+				Ref<SensorStream> sensor_stream = new SensorStream(loader);
+
+				while (Shared<SensorUpdate> sensor_update = sensor_stream->next())
+					sensor_updates.push_back(sensor_update);
+
+				Ref<SensorStream> events_stream = new SensorStream(loader);
+				Ref<SensorEvents> sensor_events = new SensorEvents(*events_stream);
+
+				examiner.check_equal(sensor_events->size(), sensor_updates.size());
+				examiner.check_equal(sensor_events->image_updates().size(), (std::size_t)12);
+
+				// The events are visited in the original order:
+				struct Visitor
+				{
+					const std::vector<Shared<SensorUpdate>> & sensor_updates;
+					UnitTest::Examiner & examiner;
+					std::size_t index;
+
+					template <typename UpdateT>
+					void operator()(const UpdateT & update)
+					{
+						auto expected = dynamic_cast<const UpdateT *>(sensor_updates.at(index).get());
+
+						examiner.check(expected != nullptr);
+						if (expected) examiner.check_equal(update.time_offset, expected->time_offset);
+
+						index += 1;
+					}
+				};
+
+				Visitor visitor{sensor_updates, examiner, 0};
+				sensor_events->visit(visitor);
+
+				examiner.check_equal(visitor.index, sensor_updates.size());
+			}
+		},
+
+		{"Check Replay Throughput",
+			[](UnitTest::Examiner & examiner) {
+				// A motion heavy log: 100Hz motion updates, with a heading update every second:
+				const std::size_t COUNT = 200000;
+
+				std::vector<Shared<SensorUpdate>> sensor_updates;
+				Ref<SensorEvents> sensor_events = new SensorEvents;
+
+				for (std::size_t i = 0; i < COUNT; i += 1) {
+					MotionUpdate motion_update;
+					motion_update.time_offset = i * 0.01;
+					motion_update.gravity = {0, -1, 0.1f * std::sin(i * 0.001f)};
+					motion_update.rotation_rate = {0, 0.2f * std::cos(i * 0.01f), 0};
+
+					sensor_updates.push_back(new MotionUpdate(motion_update));
+					sensor_events->append(motion_update);
+
+					if (i % 100 == 0) {
+						HeadingUpdate heading_update;
+						heading_update.time_offset = motion_update.time_offset;
+						heading_update.magnetic_bearing = heading_update.true_bearing = 10 + (i / 100) % 20;
+
+						sensor_updates.push_back(new HeadingUpdate(heading_update));
+						sensor_events->append(heading_update);
+					}
+				}
+
+				Ref<MotionModel> shared_model = new BasicSensorMotionModel;
+
+				Dream::Core::Stopwatch shared_watch;
+				shared_watch.start();
+
+				for (auto & sensor_update : sensor_updates)
+					shared_model->update(sensor_update.get());
+
+				shared_watch.pause();
+				auto shared_time = shared_watch.time();
+
+				Ref<BasicSensorMotionModel> events_model = new BasicSensorMotionModel;
+
+				Dream::Core::Stopwatch events_watch;
+				events_watch.start();
+
+				sensor_events->apply(*events_model);
+
+				events_watch.pause();
+				auto events_time = events_watch.time();
+
+				// Both give exactly the same result:
+				examiner.check_equal(R2D * events_model->bearing(), R2D * shared_model->bearing());
+
+				examiner << "Replayed " << sensor_updates.size() << " updates: " << (sensor_updates.size() / shared_time) << " updates/s as Shared<SensorUpdate>, " << (sensor_updates.size() / events_time) << " updates/s as SensorEvents, which still makes one virtual MotionModel::update call per event." << std::endl;
+			}
+		},
+	};
+}
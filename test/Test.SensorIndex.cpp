@@ -0,0 +1,124 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/VideoStream.h>
+#include <TransformFlow/BasicSensorMotionModel.h>
+#include <Dream/Core/Buffer.h>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace TransformFlow {
+	UnitTest::Suite SensorIndexTestSuite {
+		"Test Sensor Index Functionality",
+
+		{"Check Seeking",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				Ref<SensorData> sensor_data = new SensorData(loader);
+				auto & sensor_updates = sensor_data->sensor_updates();
+
+				Ref<SensorStream> sensor_stream = new SensorStream(loader);
+				Ref<SensorIndex> index = new SensorIndex(*sensor_stream);
+
+				examiner.check_equal(index->size(), sensor_updates.size());
+				examiner.check_equal(index->frame_count(), (std::size_t)12);
+				examiner.check_equal(index->source_size(), sensor_stream->size());
+
+				// Seeking to a frame gives its image update:
+				for (std::size_t frame = 0; frame < index->frame_count(); frame += 1) {
+					sensor_stream->seek(index->position_for_frame(frame));
+
+					Shared<ImageUpdate> image_update = sensor_stream->next();
+					examiner.check(image_update);
+					examiner.check_equal(image_update->frame_index, frame);
+					examiner.check_equal(image_update->time_offset, sensor_updates.at(sensor_data->update_for_frame(frame))->time_offset);
+				}
+
+				bool rejected = false;
+
+				try {
+					index->position_for_frame(12);
+				} catch (std::out_of_range & error) {
+					rejected = true;
+				}
+
+				examiner.check(rejected);
+
+				// Seeking to a time gives the first update at or after it, and reading continues from there:
+				TimeT time_offset = sensor_updates.at(100)->time_offset - 0.001;
+				std::size_t update = sensor_data->update_for_time(time_offset);
+
+				examiner.check(sensor_updates.at(update)->time_offset >= time_offset);
+				examiner.check(sensor_updates.at(update - 1)->time_offset < time_offset);
+
+				sensor_stream->seek(index->position_for_time(time_offset));
+
+				for (; update < sensor_updates.size(); update += 1) {
+					Shared<SensorUpdate> sensor_update = sensor_stream->next();
+					examiner.check_equal(sensor_update->time_offset, sensor_updates[update]->time_offset);
+				}
+
+				examiner.check(!sensor_stream->next());
+
+				sensor_stream->seek(index->position_for_time(1e9));
+				examiner.check(!sensor_stream->next());
+			}
+		},
+
+		{"Check Sidecar",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				Ref<SensorData> sensor_data = new SensorData(loader);
+
+				std::stringstream output;
+				sensor_data->index()->write(output);
+
+				std::string bytes = output.str();
+				Ref<SensorIndex> index = new SensorIndex(new StaticBuffer(reinterpret_cast<const ByteT *>(bytes.data()), bytes.size()));
+
+				examiner.check_equal(index->size(), sensor_data->index()->size());
+				examiner.check_equal(index->frame_count(), sensor_data->index()->frame_count());
+				examiner.check_equal(index->source_size(), sensor_data->index()->source_size());
+				examiner.check_equal(index->end().offset, sensor_data->index()->end().offset);
+
+				for (std::size_t frame = 0; frame < index->frame_count(); frame += 1)
+					examiner.check_equal(index->position_for_frame(frame).offset, sensor_data->index()->position_for_frame(frame).offset);
+
+				// Truncated files are rejected rather than read out of bounds:
+				bool rejected = false;
+
+				try {
+					Ref<SensorIndex> truncated = new SensorIndex(new StaticBuffer(reinterpret_cast<const ByteT *>(bytes.data()), bytes.size() - 8));
+				} catch (std::runtime_error & error) {
+					rejected = true;
+				}
+
+				examiner.check(rejected);
+			}
+		},
+
+		{"Check Streaming From Frame",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				Ref<SensorIndex> index = SensorIndex::load(loader);
+
+				std::vector<std::size_t> frames;
+
+				VideoStream::stream(loader, index->position_for_frame(6), new BasicSensorMotionModel, [&](const VideoStream::VideoFrame & video_frame) {
+					examiner.check_equal(video_frame.image_update->frame_index, video_frame.index);
+					frames.push_back(video_frame.index);
+				});
+
+				examiner.check_equal(frames.size(), (std::size_t)6);
+				examiner.check_equal(frames.front(), (std::size_t)6);
+				examiner.check_equal(frames.back(), (std::size_t)11);
+			}
+		},
+	};
+}
@@ -0,0 +1,100 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/ThreadPool.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+namespace TransformFlow {
+	// Calls parallel_for with a callback which throws on a thread chosen by should_throw, and checks that the exception reaches the caller only once no calls are in progress.
+	template <typename PredicateT>
+	static void check_exception(UnitTest::Examiner & examiner, Ref<ThreadPool> thread_pool, PredicateT should_throw)
+	{
+		std::atomic<std::size_t> active(0), calls(0);
+		std::atomic<bool> thrown(false);
+
+		bool caught = false;
+
+		try {
+			thread_pool->parallel_for(1000, [&](std::size_t i) {
+				active += 1;
+				calls += 1;
+
+				// Slow enough that other threads are still busy when the exception is thrown:
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+				if (!thrown && should_throw(i)) {
+					thrown = true;
+					active -= 1;
+
+					throw std::runtime_error("Callback failed!");
+				}
+
+				active -= 1;
+			});
+		} catch (std::runtime_error & error) {
+			caught = true;
+
+			examiner << "No calls were in progress when the exception was rethrown";
+			examiner.check_equal(active.load(), (std::size_t)0);
+		}
+
+		examiner << "The exception was rethrown on the calling thread";
+		examiner.check(caught);
+
+		examiner << "The remaining calls were skipped";
+		examiner.check(calls < 1000);
+
+		// Helpers which start late don't call the callback, which refers to this stack frame:
+		std::size_t finished_calls = calls;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		examiner.check_equal(calls.load(), finished_calls);
+	}
+
+	UnitTest::Suite ThreadPoolTestSuite {
+		"Test Thread Pool Functionality",
+
+		{"Check Parallel For",
+			[](UnitTest::Examiner & examiner) {
+				Ref<ThreadPool> thread_pool = new ThreadPool(4);
+
+				std::vector<std::atomic<std::size_t>> counts(1000);
+
+				for (auto & count : counts)
+					count = 0;
+
+				thread_pool->parallel_for(counts.size(), [&](std::size_t i) {
+					counts[i] += 1;
+				});
+
+				bool once = true;
+
+				for (auto & count : counts)
+					once = once && count == 1;
+
+				examiner << "Every index was called exactly once";
+				examiner.check(once);
+			}
+		},
+
+		{"Check Exceptions",
+			[](UnitTest::Examiner & examiner) {
+				Ref<ThreadPool> thread_pool = new ThreadPool(4);
+				std::thread::id caller = std::this_thread::get_id();
+
+				examiner << "An exception thrown on the calling thread";
+				check_exception(examiner, thread_pool, [&](std::size_t i) {return std::this_thread::get_id() == caller;});
+
+				examiner << "An exception thrown on a worker thread";
+				check_exception(examiner, thread_pool, [&](std::size_t i) {return std::this_thread::get_id() != caller;});
+
+				// The pool is still usable afterwards:
+				std::atomic<std::size_t> calls(0);
+				thread_pool->parallel_for(100, [&](std::size_t i) {calls += 1;});
+
+				examiner.check_equal(calls.load(), (std::size_t)100);
+			}
+		},
+	};
+}
@@ -0,0 +1,293 @@
+
+#include <UnitTest/UnitTest.h>
+#include <TransformFlow/VideoStream.h>
+#include <TransformFlow/BasicSensorMotionModel.h>
+#include <TransformFlow/HybridMotionModel.h>
+#include <TransformFlow/Dataset.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace TransformFlow {
+	// Exposes VideoStream::replay, so that it can be given updates directly.
+	class ReplayVideoStream : public VideoStream
+	{
+	public:
+		using VideoStream::replay;
+	};
+
+	// Counts the motion updates which have been processed.
+	class CountingMotionModel : public BasicSensorMotionModel
+	{
+	public:
+		std::size_t motion_updates = 0;
+
+		using BasicSensorMotionModel::update;
+
+		virtual void update(const MotionUpdate & motion_update)
+		{
+			motion_updates += 1;
+
+			BasicSensorMotionModel::update(motion_update);
+		}
+	};
+
+	static void write_file(const std::string & path, Shared<Buffer> buffer)
+	{
+		std::ofstream output(path, std::ios::binary);
+		output.write(reinterpret_cast<const char *>(buffer->begin()), buffer->size());
+	}
+
+	UnitTest::Suite VideoStreamTestSuite {
+		"Test Video Stream Functionality",
+
+		{"Check Streaming",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				Ref<SensorData> sensor_data = new SensorData(loader);
+				Ref<SensorStream> sensor_stream = new SensorStream(loader);
+
+				std::size_t count = 0;
+
+				while (Shared<SensorUpdate> sensor_update = sensor_stream->next()) {
+					examiner.check_equal(sensor_update->time_offset, sensor_data->sensor_updates().at(count)->time_offset);
+					count += 1;
+				}
+
+				examiner.check_equal(count, sensor_data->sensor_updates().size());
+
+				Ref<VideoStream> video_stream = new VideoStream(loader, new BasicSensorMotionModel);
+
+				std::size_t index = 0;
+
+				// Streaming gives the same frames without keeping them:
+				VideoStream::stream(loader, new BasicSensorMotionModel, [&](const VideoStream::VideoFrame & video_frame) {
+					auto & expected = video_stream->frames().at(index);
+
+					examiner.check_equal(video_frame.index, expected.index);
+					examiner.check_equal(video_frame.valid, expected.valid);
+					examiner.check_equal(video_frame.image_update->frame_index, expected.image_update->frame_index);
+
+					if (video_frame.valid) {
+						examiner.check_equal(R2D * video_frame.bearing, R2D * expected.bearing);
+						examiner.check_equal(video_frame.feature_points->offsets().size(), expected.feature_points->offsets().size());
+					}
+
+					index += 1;
+				});
+
+				examiner.check_equal(index, video_stream->frames().size());
+				examiner.check_equal(index, (std::size_t)12);
+			}
+		},
+
+		{"Check Checkpoints",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				Ref<VideoStream> video_stream = new VideoStream(loader, new BasicSensorMotionModel, nullptr, 8, 4);
+
+				examiner.check_equal(video_stream->checkpoints().size(), (std::size_t)3);
+				examiner.check(video_stream->checkpoint_for_frame(3)->frame == 0);
+
+				auto checkpoint = video_stream->checkpoint_for_frame(9);
+				examiner.check_equal(checkpoint->frame, (std::size_t)8);
+
+				// Resuming from a checkpoint gives the same frames as replaying from the start:
+				std::size_t index = checkpoint->frame;
+
+				VideoStream::resume(loader, video_stream->sensor_data()->index(), *checkpoint, new BasicSensorMotionModel, [&](const VideoStream::VideoFrame & video_frame) {
+					auto & expected = video_stream->frames().at(index);
+
+					examiner.check_equal(video_frame.index, index);
+					examiner.check_equal(video_frame.valid, expected.valid);
+					examiner.check_equal(R2D * video_frame.bearing, R2D * expected.bearing);
+
+					index += 1;
+				});
+
+				examiner.check_equal(index, video_stream->frames().size());
+			}
+		},
+
+		{"Check Parallel Loading",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				std::size_t fusion_completed = 0, features_completed = 0, features_total = 0;
+
+				Ref<VideoStream> video_stream = new VideoStream(loader, new BasicSensorMotionModel, new ThreadPool(4), 8, 0, [&](VideoStream::LoadPhase phase, std::size_t completed, std::size_t total) {
+					if (phase == VideoStream::LoadPhase::FUSION) {
+						examiner.check_equal(completed, fusion_completed + 1);
+						examiner.check_equal(total, (std::size_t)12);
+
+						fusion_completed = completed;
+					} else {
+						// The fusion pass is finished before any feature points are scanned:
+						examiner.check_equal(fusion_completed, (std::size_t)12);
+						examiner.check_equal(completed, features_completed + 1);
+
+						features_completed = completed;
+						features_total = total;
+					}
+				});
+
+				examiner.check_equal(features_completed, features_total);
+
+				// The model doesn't use the images, so each one is only decoded when its feature points are scanned:
+				examiner << "Only the valid frames were decoded, once each";
+				examiner.check_equal(video_stream->sensor_data()->frame_cache()->loads(), features_total);
+
+				std::size_t valid_frames = 0;
+
+				// Scanning frames in parallel gives the same feature points as scanning them while streaming:
+				VideoStream::stream(loader, new BasicSensorMotionModel, [&](const VideoStream::VideoFrame & video_frame) {
+					auto & expected = video_stream->frames().at(video_frame.index);
+
+					examiner.check_equal(expected.valid, video_frame.valid);
+
+					if (video_frame.valid) {
+						examiner.check(bool(expected.feature_points));
+						examiner.check(expected.feature_points->offsets() == video_frame.feature_points->offsets());
+
+						valid_frames += 1;
+					}
+				});
+
+				examiner.check_equal(valid_frames, features_total);
+
+				// A model which uses the images decodes them all in the fusion pass, and the feature pass finds them in the frame cache:
+				Ref<VideoStream> hybrid_stream = new VideoStream(loader, new HybridMotionModel, new ThreadPool(4));
+
+				examiner << "Each frame was decoded once";
+				examiner.check_equal(hybrid_stream->sensor_data()->frame_cache()->loads(), (std::size_t)12);
+			}
+		},
+
+		{"Check Bounded Lookahead",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				// A long stretch of motion updates without any frames, followed by a single frame:
+				const std::size_t count = VideoStream::MAXIMUM_LOOKAHEAD * 3;
+
+				Ref<CountingMotionModel> motion_model = new CountingMotionModel;
+				std::size_t read = 0, maximum_buffered = 0;
+
+				auto next_update = [&]() -> Shared<SensorUpdate> {
+					maximum_buffered = std::max(maximum_buffered, read - motion_model->motion_updates);
+
+					if (read < count) {
+						Shared<MotionUpdate> motion_update = new MotionUpdate;
+						motion_update->time_offset = read * 0.01;
+						motion_update->gravity = {0, -1, 0};
+
+						read += 1;
+
+						return motion_update;
+					} else if (read == count) {
+						Shared<ImageUpdate> image_update = new ImageUpdate;
+						image_update->time_offset = read * 0.01;
+						image_update->image_buffer = loader->load<Image>("0");
+
+						read += 1;
+
+						return image_update;
+					}
+
+					return nullptr;
+				};
+
+				std::size_t frames = 0;
+
+				ReplayVideoStream::replay(next_update, *motion_model, new ThreadPool(2), 8, [&](const VideoStream::VideoFrame & video_frame) {
+					frames += 1;
+				});
+
+				examiner << "Every update was processed";
+				examiner.check_equal(motion_model->motion_updates, count);
+				examiner.check_equal(frames, (std::size_t)1);
+
+				examiner << "Buffered at most " << maximum_buffered << " updates ahead of the motion model";
+				examiner.check(maximum_buffered <= VideoStream::MAXIMUM_LOOKAHEAD);
+			}
+		},
+
+		{"Check Missing Images",
+			[](UnitTest::Examiner & examiner) {
+				Ref<Resources::Loader> loader = new Resources::Loader("../share/transform-flow/datasets/sample");
+				loader->add_loader(new Image::Loader);
+
+				// A copy of the sample, without the image for frame 5:
+				char directory[] = "/tmp/transform-flow-XXXXXX";
+				examiner.check(mkdtemp(directory) != nullptr);
+
+				std::vector<std::string> paths;
+
+				paths.push_back(std::string(directory) + "/log.csv");
+				write_file(paths.back(), loader->data_for_resource("log")->buffer());
+
+				for (std::size_t frame_index = 0; frame_index < 12; frame_index += 1) {
+					if (frame_index == 5) continue;
+
+					paths.push_back(std::string(directory) + "/" + to_string(frame_index) + ".png");
+					write_file(paths.back(), loader->data_for_resource(to_string(frame_index))->buffer());
+				}
+
+				Ref<Resources::Loader> copy_loader = new Resources::Loader(directory);
+				copy_loader->add_loader(new Image::Loader);
+
+				// The missing image is written as an empty frame:
+				std::stringstream output;
+				Dataset::convert(copy_loader, output);
+
+				std::string bytes = output.str();
+
+				paths.push_back(std::string(directory) + "/" + Dataset::RESOURCE_NAME + ".tfd");
+				write_file(paths.back(), new StaticBuffer(reinterpret_cast<const ByteT *>(bytes.data()), bytes.size()));
+
+				Ref<Resources::Loader> dataset_loader = new Resources::Loader(directory);
+				dataset_loader->add_loader(new Image::Loader);
+
+				examiner << "The converted data set is used in preference to the log";
+				examiner.check(bool(dataset_loader->data_for_resource(Dataset::RESOURCE_NAME)));
+
+				// The frame without an image is skipped by the vision correction, rather than being scanned:
+				Ref<VideoStream> video_stream = new VideoStream(dataset_loader, new HybridMotionModel, new ThreadPool(2));
+
+				examiner.check_equal(video_stream->frames().size(), (std::size_t)12);
+
+				for (auto & video_frame : video_stream->frames()) {
+					if (video_frame.index == 5) {
+						examiner << "Frame 5 has no image";
+						examiner.check(!video_frame.image_update->image());
+					}
+
+					if (!video_frame.valid) continue;
+
+					if (video_frame.index == 5) {
+						examiner << "Frame 5 has no feature points";
+						examiner.check(!video_frame.feature_points->scanned());
+						examiner.check_equal(video_frame.feature_points->offsets().size(), (std::size_t)0);
+					} else {
+						examiner.check(video_frame.feature_points->scanned());
+					}
+				}
+
+				for (auto & path : paths)
+					std::remove(path.c_str());
+
+				rmdir(directory);
+			}
+		},
+	};
+}